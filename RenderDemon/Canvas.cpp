@@ -0,0 +1,1653 @@
+#include "Canvas.h"
+#include "Util.h"
+#include "Memory.h"
+#include "Capture.h"
+#include "Jobs.h"
+#include <algorithm>
+#include <cmath>
+#include <new>
+#include <thread>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+    // floor(value * num / den), also for negative values.
+    int scaleCoord(int value, int num, int den)
+    {
+        int64 scaled = (int64)value * num;
+        if (scaled < 0)
+        {
+            scaled -= den - 1;
+        }
+        return (int)(scaled / den);
+    }
+
+    int roundCoord(f32 value)
+    {
+        return (int)floorf(value + 0.5f);
+    }
+
+    void upscaleRow(const Kernels::Table& k, uint32* dst, const uint32* src, int count, int scale)
+    {
+        k.upscaleRow(dst, src, count, scale);
+    }
+
+    void upscaleRow(const Kernels::Table&, uint16* dst, const uint16* src, int count, int scale)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            for (int j = 0; j < scale; ++j)
+            {
+                *dst++ = src[i];
+            }
+        }
+    }
+}
+
+Canvas::Canvas(int width, int height, PixelFormat format)
+    : m_width(width),
+    m_height(height),
+    m_renderScale(100),
+    m_renderWidth(width),
+    m_renderHeight(height),
+    m_ops(formatOps(format)),
+    m_drawAlpha(255),
+    m_drawIndex(-1),
+    m_drawPixel(0),
+    m_clearIndex(-1),
+    m_hasColorKey(false),
+    m_colorKeyPixel(0),
+    m_paletteVersion(0),
+    m_colorMaps(nullptr),
+    m_light(0),
+    m_lightMap(nullptr),
+    m_blendRow(nullptr),
+    m_interlace(Interlace::None),
+    m_reconstruct(Reconstruct::Copy),
+    m_parity(0),
+    m_scissorDepth(0),
+    m_transformDepth(0),
+    m_dither(Dither::None),
+    m_ditherSpread(64),
+    m_ditherSpan(false),
+    m_diffuseProgress(nullptr),
+    m_jobs(nullptr),
+    m_kernels(&Kernels::active()),
+    m_capture(nullptr),
+    m_captureDepth(0),
+    m_parent(nullptr)
+{
+    Memory::Scope memoryScope(Memory::Tag::Video);
+
+    m_surface = createSurface();
+
+    const int cDefaultColorPaletteCount = 16;
+    m_defaultColorPalette = new SDL_Color[cDefaultColorPaletteCount];
+
+    m_defaultColorPalette[0x0] = { 128, 128, 128, 255 };
+    m_defaultColorPalette[0x1] = { 0, 0, 255, 255 };
+    m_defaultColorPalette[0x2] = { 0, 255, 0, 255 };
+    m_defaultColorPalette[0x3] = { 0, 255, 255, 255 };
+
+    m_defaultColorPalette[0x4] = { 255, 0, 0, 255 };
+    m_defaultColorPalette[0x5] = { 255, 0, 255, 255 };
+    m_defaultColorPalette[0x6] = { 255, 255, 0, 255 };
+    m_defaultColorPalette[0x7] = { 255, 255, 255, 255 };
+
+    m_defaultColorPalette[0x8] = { 128, 128, 128, 255 };
+    m_defaultColorPalette[0x9] = { 0, 0, 255, 255 };
+    m_defaultColorPalette[0xA] = { 0, 255, 0, 255 };
+    m_defaultColorPalette[0xB] = { 0, 255, 255, 255 };
+
+    m_defaultColorPalette[0xC] = { 255, 0, 0, 255 };
+    m_defaultColorPalette[0xD] = { 255, 0, 255, 255 };
+    m_defaultColorPalette[0xE] = { 255, 255, 0, 255 };
+    m_defaultColorPalette[0xF] = { 255, 255, 255, 255 };
+
+    const SDL_Color cWhite = { 255, 255, 255, 255 };
+    const SDL_Color cBlack = { 0, 0, 0, 255 };
+    m_drawColor = cWhite;
+    m_clearColor = cBlack;
+
+    setColorPalette(m_defaultColorPalette, cDefaultColorPaletteCount);
+    resetView();
+}
+
+SDL_Surface* Canvas::createSurface() const
+{
+    return SDL_CreateRGBSurface(0, m_width, m_height, m_ops->bitsPerPixel,
+        m_ops->rmask,
+        m_ops->gmask,
+        m_ops->bmask,
+        0x00000000);
+}
+
+SDL_Surface* Canvas::swapSurface(SDL_Surface* surface)
+{
+    SDL_Surface* previous = m_surface;
+    m_surface = surface;
+    return previous;
+}
+
+Canvas::FrameSource Canvas::frameSource() const
+{
+    FrameSource source = { m_surface, m_renderWidth, m_renderHeight, m_paletteARGB };
+    return source;
+}
+
+Canvas::Canvas(const Canvas* parent)
+    : m_width(parent->m_width),
+    m_height(parent->m_height),
+    m_renderScale(100),
+    m_renderWidth(parent->m_width),
+    m_renderHeight(parent->m_height),
+    m_ops(parent->m_ops),
+    m_surface(nullptr),
+    m_drawAlpha(255),
+    m_drawIndex(-1),
+    m_drawPixel(0),
+    m_clearIndex(-1),
+    m_hasColorKey(false),
+    m_colorKeyPixel(0),
+    m_defaultColorPalette(nullptr),
+    m_colorPalette(nullptr),
+    m_colorPaletteCount(0),
+    m_paletteVersion(parent->m_paletteVersion - 1),
+    m_colorMaps(nullptr),
+    m_light(0),
+    m_lightMap(nullptr),
+    m_blendRow(nullptr),
+    m_interlace(Interlace::None),
+    m_reconstruct(Reconstruct::Copy),
+    m_parity(0),
+    m_scissorDepth(0),
+    m_transformDepth(0),
+    m_dither(Dither::None),
+    m_ditherSpread(64),
+    m_ditherSpan(false),
+    m_diffuseProgress(nullptr),
+    m_jobs(nullptr),
+    m_kernels(parent->m_kernels),
+    m_capture(nullptr),
+    m_captureDepth(0),
+    m_parent(parent)
+{
+    shareFrom(*parent);
+}
+
+void Canvas::shareFrom(const Canvas& parent)
+{
+    m_surface = parent.m_surface;
+    m_renderScale = parent.m_renderScale;
+    m_renderWidth = parent.m_renderWidth;
+    m_renderHeight = parent.m_renderHeight;
+    m_kernels = parent.m_kernels;
+    m_jobs = parent.m_jobs;
+    m_interlace = parent.m_interlace;
+    m_reconstruct = parent.m_reconstruct;
+    m_parity = parent.m_parity;
+
+    // The 32K lookup table is only copied when the palette has changed; the
+    // colormaps stay the parent's.
+    if (m_paletteVersion != parent.m_paletteVersion)
+    {
+        m_paletteVersion = parent.m_paletteVersion;
+        m_colorPalette = parent.m_colorPalette;
+        m_colorPaletteCount = parent.m_colorPaletteCount;
+        memcpy(m_paletteColors, parent.m_paletteColors, sizeof(m_paletteColors));
+        memcpy(m_paletteARGB, parent.m_paletteARGB, sizeof(m_paletteARGB));
+        m_paletteLut = parent.m_paletteLut;
+        m_colorMaps = parent.m_colorMaps;
+    }
+    if (m_dither != parent.m_dither || m_ditherSpread != parent.m_ditherSpread)
+    {
+        setDither(parent.m_dither, parent.m_ditherSpread);
+    }
+
+    m_drawColor = parent.m_drawColor;
+    m_drawIndex = parent.m_drawIndex;
+    m_drawAlpha = parent.m_drawAlpha;
+    m_light = parent.m_light;
+    m_clearColor = parent.m_clearColor;
+    m_clearIndex = parent.m_clearIndex;
+    m_hasColorKey = parent.m_hasColorKey;
+    m_colorKey = parent.m_colorKey;
+    m_colorKeyPixel = parent.m_colorKeyPixel;
+    updateDrawPixel();
+
+    m_scissorDepth = parent.m_scissorDepth;
+    std::copy(parent.m_scissors, parent.m_scissors + m_scissorDepth + 1, m_scissors);
+    m_clip = parent.m_clip;
+    m_transformDepth = parent.m_transformDepth;
+    std::copy(parent.m_transforms, parent.m_transforms + m_transformDepth, m_transforms);
+    updateTransform();
+}
+
+Canvas::~Canvas()
+{
+    if (!m_parent)
+    {
+        SDL_FreeSurface(m_surface);
+        delete m_colorMaps;
+    }
+    delete[] m_defaultColorPalette;
+    delete[] m_diffuseProgress;
+}
+
+void Canvas::setCapture(DrawCapture* capture)
+{
+    m_capture = capture;
+
+    // Seed the capture with the current state so replay starts from the same place.
+    if (m_capture)
+    {
+        m_capture->recordPalette(m_colorPalette, m_colorPaletteCount);
+        m_capture->record(DrawOp::SetClearColorRGB, { m_clearColor.r, m_clearColor.g, m_clearColor.b });
+        m_capture->record(DrawOp::SetDrawColorRGB, { m_drawColor.r, m_drawColor.g, m_drawColor.b });
+    }
+}
+
+void Canvas::setRenderScale(int percent)
+{
+    m_renderScale = Util::Max(1, Util::Min(percent, 100));
+    m_renderWidth = Util::Max(1, m_width * m_renderScale / 100);
+    m_renderHeight = Util::Max(1, m_height * m_renderScale / 100);
+    resetView();
+}
+
+void Canvas::setInterlace(Interlace mode, Reconstruct reconstruct)
+{
+    m_interlace = mode;
+    m_reconstruct = reconstruct;
+    m_parity = 0;
+}
+
+Transform Transform::rotation(f32 radians)
+{
+    f32 c = cosf(radians);
+    f32 s = sinf(radians);
+    Transform t = { c, s, -s, c, 0.f, 0.f };
+    return t;
+}
+
+Transform Transform::operator*(const Transform& o) const
+{
+    Transform t = {
+        a * o.a + c * o.b,
+        b * o.a + d * o.b,
+        a * o.c + c * o.d,
+        b * o.c + d * o.d,
+        a * o.tx + c * o.ty + tx,
+        b * o.tx + d * o.ty + ty,
+    };
+    return t;
+}
+
+bool Transform::integerTranslation() const
+{
+    return a == 1.f && b == 0.f && c == 0.f && d == 1.f && tx == floorf(tx) && ty == floorf(ty);
+}
+
+int Canvas::toRenderX(int x) const
+{
+    return m_renderWidth == m_width ? x : scaleCoord(x, m_renderWidth, m_width);
+}
+
+int Canvas::toRenderY(int y) const
+{
+    return m_renderHeight == m_height ? y : scaleCoord(y, m_renderHeight, m_height);
+}
+
+Point Canvas::mapPoint(int x, int y) const
+{
+    Point p;
+    if (m_translateOnly)
+    {
+        p.x = toRenderX(x + m_translateX);
+        p.y = toRenderY(y + m_translateY);
+    }
+    else
+    {
+        p.x = toRenderX(roundCoord(m_transform.a * x + m_transform.c * y + m_transform.tx));
+        p.y = toRenderY(roundCoord(m_transform.b * x + m_transform.d * y + m_transform.ty));
+    }
+    return p;
+}
+
+void Canvas::updateTransform()
+{
+    m_transform = m_transformDepth > 0 ? m_transforms[m_transformDepth - 1] : Transform::identity();
+    m_translateOnly = m_transform.integerTranslation();
+    m_translateX = (int)m_transform.tx;
+    m_translateY = (int)m_transform.ty;
+}
+
+void Canvas::setColorPalette(SDL_Color* palette, int count)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->recordPalette(palette, count); }
+
+    // Views share their parent's palette tables.
+    if (m_parent)
+    {
+        return;
+    }
+
+    // Compared before the copies below are overwritten.
+    const bool changed = count != m_colorPaletteCount ||
+        memcmp(palette, m_paletteColors, Util::Min(count, 256) * sizeof(SDL_Color)) != 0;
+    const bool rebuild = !m_colorMaps || changed;
+    if (changed)
+    {
+        ++m_paletteVersion;
+    }
+    m_colorPalette = palette;
+    m_colorPaletteCount = count;
+
+    // Fixed 256-entry copies so indexed readback and upload never index past
+    // the end of a short palette.
+    for (int i = 0; i < 256; ++i)
+    {
+        const SDL_Color cBlack = { 0, 0, 0, 255 };
+        const SDL_Color& c = i < count ? palette[i] : cBlack;
+        m_paletteColors[i] = c;
+        m_paletteARGB[i] = 0xFF000000 | ((uint32)c.r << 16) | ((uint32)c.g << 8) | c.b;
+    }
+
+    // Single colors are still matched exactly when they are set; the tables
+    // are for per-pixel work such as converted blits, dithering, blending
+    // and shading. They take a few ms, so only a different palette rebuilds them.
+    if (m_ops->format == PixelFormat::Indexed8 && rebuild)
+    {
+        Memory::Scope memoryScope(Memory::Tag::Video);
+        if (!m_colorMaps)
+        {
+            m_colorMaps = new ColorMaps;
+        }
+        m_paletteLut.build(m_paletteColors, Util::Min(count, 256));
+        m_colorMaps->build(m_paletteColors, Util::Min(count, 256), m_paletteLut);
+    }
+
+    updateDrawPixel();
+}
+
+int Canvas::paletteIndex(uint8 r, uint8 g, uint8 b) const
+{
+    if (m_ops->format == PixelFormat::Indexed8)
+    {
+        return m_paletteLut.index(r, g, b);
+    }
+
+    const SDL_Color color = { r, g, b, 255 };
+    return Palette::nearest(m_colorPalette, Util::Min(m_colorPaletteCount, 256), color);
+}
+
+void Canvas::setDither(Dither mode, int spread)
+{
+    Memory::Scope memoryScope(Memory::Tag::Video);
+
+    m_dither = mode;
+    m_ditherSpread = spread;
+    if (mode == Dither::FloydSteinberg && !m_diffuseProgress)
+    {
+        m_diffuseError.resize((m_width + 2) * 3 * (m_height + 1));
+        m_diffuseProgress = new std::atomic<int>[m_height];
+    }
+    updateDrawPixel();
+}
+
+void Canvas::setDrawColor(uint8 r, uint8 g, uint8 b)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::SetDrawColorRGB, { r, g, b }); }
+
+    m_drawColor.r = r;
+    m_drawColor.g = g;
+    m_drawColor.b = b;
+    m_drawIndex = -1;
+    updateDrawPixel();
+}
+
+void Canvas::setDrawColor(int index)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::SetDrawColorIndex, { index }); }
+
+    assert(index >= 0 && index < m_colorPaletteCount);
+    m_drawColor = m_colorPalette[index];
+    m_drawIndex = index;
+    updateDrawPixel();
+}
+
+void Canvas::setDrawAlpha(uint8 alpha)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::SetDrawAlpha, { alpha }); }
+
+    m_drawAlpha = alpha;
+    updateDrawPixel();
+}
+
+void Canvas::setDrawLight(int level)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::SetDrawLight, { level }); }
+
+    m_light = Util::Clamp(level, 0, ColorMaps::cLightLevels - 1);
+    updateDrawPixel();
+}
+
+void Canvas::setClearColor(uint8 r, uint8 g, uint8 b)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::SetClearColorRGB, { r, g, b }); }
+
+    m_clearColor.r = r;
+    m_clearColor.g = g;
+    m_clearColor.b = b;
+    m_clearIndex = -1;
+}
+
+void Canvas::setClearColor(int index)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::SetClearColorIndex, { index }); }
+
+    assert(index >= 0 && index < m_colorPaletteCount);
+    m_clearColor = m_colorPalette[index];
+    m_clearIndex = index;
+}
+
+void Canvas::clear()
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::Clear); }
+
+    resetView();
+    (this->*m_ops->clear)(mapColor(m_clearColor, m_clearIndex));
+}
+
+void Canvas::endInterlacedFrame()
+{
+    if (m_interlace == Interlace::None)
+    {
+        return;
+    }
+
+    if (m_reconstruct == Reconstruct::Blend)
+    {
+        (this->*m_ops->reconstruct)();
+    }
+    m_parity ^= 1;
+}
+
+void Canvas::setColorKey(uint8 r, uint8 g, uint8 b)
+{
+    SDL_Color key = { r, g, b, 255 };
+    m_hasColorKey = true;
+    m_colorKey = key;
+    m_colorKeyPixel = mapColor(key, -1);
+}
+
+void Canvas::setColorKey(int index)
+{
+    assert(index >= 0 && index < m_colorPaletteCount);
+    m_hasColorKey = true;
+    m_colorKey = m_colorPalette[index];
+    m_colorKeyPixel = mapColor(m_colorKey, index);
+}
+
+void Canvas::clearColorKey()
+{
+    m_hasColorKey = false;
+}
+
+void Canvas::blit(const Canvas& source, int x, int y)
+{
+    bool scaled = m_renderWidth != m_width || m_renderHeight != m_height || !m_translateOnly;
+    if (scaled || source.m_ops != m_ops)
+    {
+        blitConverted(source, x, y);
+        return;
+    }
+
+    int dx = x + m_translateX;
+    int dy = y + m_translateY;
+    int x1 = Util::Max(dx, m_clip.left);
+    int y1 = Util::Max(dy, m_clip.top);
+    int x2 = Util::Min(dx + source.m_width, m_clip.right);
+    int y2 = Util::Min(dy + source.m_height, m_clip.bottom);
+    if (x1 >= x2 || y1 >= y2)
+    {
+        return;
+    }
+
+    (this->*m_ops->blit)(source, x1, y1, x1 - dx, y1 - dy, x2 - x1, y2 - y1);
+}
+
+// Any format pair, render scale or transform: nearest-neighbour through RGB
+// into the bounds of the mapped corners.
+void Canvas::blitConverted(const Canvas& source, int x, int y)
+{
+    Point p1 = mapPoint(x, y);
+    Point p2 = mapPoint(x + source.m_width, y + source.m_height);
+    int rx1 = Util::Min(p1.x, p2.x), rx2 = Util::Max(p1.x, p2.x);
+    int ry1 = Util::Min(p1.y, p2.y), ry2 = Util::Max(p1.y, p2.y);
+    if (rx1 >= rx2 || ry1 >= ry2)
+    {
+        return;
+    }
+
+    int x1 = Util::Max(rx1, m_clip.left), x2 = Util::Min(rx2, m_clip.right);
+    int y1 = Util::Max(ry1, m_clip.top), y2 = Util::Min(ry2, m_clip.bottom);
+    if (x1 >= x2 || y1 >= y2)
+    {
+        return;
+    }
+
+    const bool indexed = m_ops->format == PixelFormat::Indexed8;
+    const bool dither = indexed && m_dither != Dither::None;
+    if (dither && m_dither == Dither::FloydSteinberg)
+    {
+        blitDiffused(source, rx1, ry1, rx2, ry2, x1, y1, x2, y2);
+        return;
+    }
+
+    // Unscaled 32-bit images into an indexed canvas, as when converting them
+    // at load time: whole rows go through the palette table.
+    const PixelFormat sourceFormat = source.m_ops->format;
+    if (indexed && !dither && !source.m_hasColorKey && rx2 - rx1 == source.m_width && ry2 - ry1 == source.m_height &&
+        (sourceFormat == PixelFormat::ARGB8888 || sourceFormat == PixelFormat::ABGR8888))
+    {
+        for (int v = y1; v < y2; ++v)
+        {
+            uint8* dst = pixelAt<FormatIndexed8>(x1, v);
+            m_paletteLut.map(dst, surfaceRow<FormatARGB8888>(source.m_surface, v - ry1) + (x1 - rx1), x2 - x1,
+                sourceFormat == PixelFormat::ABGR8888);
+            if (m_lightMap)
+            {
+                for (int u = 0; u < x2 - x1; ++u)
+                {
+                    dst[u] = m_lightMap[dst[u]];
+                }
+            }
+        }
+        return;
+    }
+
+    for (int v = y1; v < y2; ++v)
+    {
+        int srcY = (v - ry1) * source.m_height / (ry2 - ry1);
+        for (int u = x1; u < x2; ++u)
+        {
+            int srcX = (u - rx1) * source.m_width / (rx2 - rx1);
+            SDL_Color color = source.getPixelColor(srcX, srcY);
+            if (source.m_hasColorKey && rgbEqual(color, source.m_colorKey))
+            {
+                continue;
+            }
+            uint32 value;
+            if (dither)
+            {
+                value = ditherIndex(color, u, v);
+            }
+            else
+            {
+                value = indexed ? m_paletteLut.index(color.r, color.g, color.b) : mapColor(color, -1);
+            }
+            if (m_lightMap)
+            {
+                value = m_lightMap[value];
+            }
+            (this->*m_ops->write)(u, v, value);
+        }
+    }
+}
+
+namespace
+{
+    struct DiffuseJob
+    {
+        Canvas* target;
+        const Canvas* source;
+        int rx1, ry1, rx2, ry2;
+        int x1, y1, x2, y2;
+        int rows;
+        std::atomic<int> nextRow;
+    };
+}
+
+void Canvas::blitDiffused(const Canvas& source, int rx1, int ry1, int rx2, int ry2, int x1, int y1, int x2, int y2)
+{
+    const int rows = y2 - y1;
+    const int stride = (m_width + 2) * 3;
+    std::fill(m_diffuseError.begin(), m_diffuseError.begin() + stride, (int16)0);
+    for (int row = 0; row < rows; ++row)
+    {
+        m_diffuseProgress[row].store(-1, std::memory_order_relaxed);
+    }
+
+    DiffuseJob job;
+    job.target = this;
+    job.source = &source;
+    job.rx1 = rx1, job.ry1 = ry1, job.rx2 = rx2, job.ry2 = ry2;
+    job.x1 = x1, job.y1 = y1, job.x2 = x2, job.y2 = y2;
+    job.rows = rows;
+    job.nextRow.store(0, std::memory_order_relaxed);
+
+    // One runner per thread, each taking the next row in order rather than a
+    // fixed range, so the row any of them waits on is always already running.
+    const int runners = m_jobs ? Util::Min(m_jobs->threads(), rows) : 1;
+    if (m_jobs)
+    {
+        m_jobs->parallelFor(runners, 1, diffuseRows, &job);
+    }
+    else
+    {
+        diffuseRows(&job, 0, 1);
+    }
+}
+
+void Canvas::diffuseRows(void* context, int, int)
+{
+    DiffuseJob& job = *(DiffuseJob*)context;
+    for (int row = job.nextRow.fetch_add(1, std::memory_order_relaxed); row < job.rows;
+        row = job.nextRow.fetch_add(1, std::memory_order_relaxed))
+    {
+        diffuseRow(&job, row);
+    }
+}
+
+void Canvas::diffuseRow(void* context, int row)
+{
+    const DiffuseJob& job = *(const DiffuseJob*)context;
+    Canvas* self = job.target;
+    const Canvas& source = *job.source;
+    const int width = job.x2 - job.x1;
+    const int stride = (self->m_width + 2) * 3;
+
+    // Error rows are padded by a pixel either side. This row's was cleared
+    // by the row above before it started; the next one is cleared here.
+    int16* error = &self->m_diffuseError[row * stride];
+    int16* below = error + stride;
+    std::fill(below, below + (width + 2) * 3, (int16)0);
+
+    const std::atomic<int>* above = row > 0 ? &self->m_diffuseProgress[row - 1] : nullptr;
+    std::atomic<int>& progress = self->m_diffuseProgress[row];
+
+    const int v = job.y1 + row;
+    const int srcY = (v - job.ry1) * source.m_height / (job.ry2 - job.ry1);
+    int carry[3] = { 0, 0, 0 };
+    for (int i = 0; i < width; ++i)
+    {
+        // The row above adds into columns i - 1 .. i + 1 of this one.
+        const int needed = Util::Min(i + 1, width - 1);
+        while (above && above->load(std::memory_order_acquire) < needed)
+        {
+            std::this_thread::yield();
+        }
+
+        const int u = job.x1 + i;
+        const int srcX = (u - job.rx1) * source.m_width / (job.rx2 - job.rx1);
+        SDL_Color color = source.getPixelColor(srcX, srcY);
+        if (source.m_hasColorKey && rgbEqual(color, source.m_colorKey))
+        {
+            carry[0] = carry[1] = carry[2] = 0;
+            progress.store(i, std::memory_order_release);
+            continue;
+        }
+
+        int16* e = error + (i + 1) * 3;
+        int16* b = below + (i + 1) * 3;
+        int want[3] = { color.r + e[0] + carry[0], color.g + e[1] + carry[1], color.b + e[2] + carry[2] };
+        for (int ch = 0; ch < 3; ++ch)
+        {
+            want[ch] = Util::Clamp(want[ch], 0, 255);
+        }
+        const int index = self->m_paletteLut.index((uint8)want[0], (uint8)want[1], (uint8)want[2]);
+        // Shading applies to the written pixel only; the error is measured
+        // against the unlit color so the pattern matches an unshaded blit.
+        (self->*self->m_ops->write)(u, v, self->m_lightMap ? self->m_lightMap[index] : (uint32)index);
+
+        // 7/16 right (kept in carry, as the row above may still be adding to
+        // this one), 3/16 below left, 5/16 below, 1/16 below right.
+        const SDL_Color& chosen = self->m_colorPalette[index];
+        const int got[3] = { chosen.r, chosen.g, chosen.b };
+        for (int ch = 0; ch < 3; ++ch)
+        {
+            const int err = want[ch] - got[ch];
+            carry[ch] = err * 7 / 16;
+            b[ch - 3] = (int16)(b[ch - 3] + err * 3 / 16);
+            b[ch] = (int16)(b[ch] + err * 5 / 16);
+            b[ch + 3] = (int16)(b[ch + 3] + err * 1 / 16);
+        }
+        progress.store(i, std::memory_order_release);
+    }
+}
+
+uint32 Canvas::mapColor(const SDL_Color& color, int index) const
+{
+    // Palette draws on an indexed target store the index itself rather than
+    // the nearest match, so duplicate palette entries stay distinct.
+    if (index >= 0 && m_ops->format == PixelFormat::Indexed8)
+    {
+        return (uint32)index;
+    }
+    return (this->*m_ops->pack)(color);
+}
+
+void Canvas::updateDrawPixel()
+{
+    m_drawPixel = mapColor(m_drawColor, m_drawIndex);
+
+    const bool indexed = m_ops->format == PixelFormat::Indexed8 && m_colorMaps;
+    m_lightMap = indexed && m_light > 0 ? m_colorMaps->light(m_light) : nullptr;
+    if (m_lightMap)
+    {
+        m_drawPixel = m_lightMap[m_drawPixel];
+    }
+
+    m_blendRow = nullptr;
+    if (indexed && m_drawAlpha != 255)
+    {
+        m_blendRow = m_colorMaps->translucency(ColorMaps::translucencyLevel(m_drawAlpha)) + m_drawPixel * 256;
+    }
+
+    // Palette draws stay exact; only opaque RGB colors are dithered.
+    m_ditherSpan = indexed && m_dither != Dither::None && m_drawIndex < 0 && m_drawAlpha == 255;
+    if (m_ditherSpan)
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            for (int x = 0; x < 4; ++x)
+            {
+                uint8 index = ditherIndex(m_drawColor, x, y);
+                m_ditherRows[y][x] = m_ditherRows[y][x + 4] = m_lightMap ? m_lightMap[index] : index;
+            }
+        }
+    }
+}
+
+void Canvas::blendIndexed(uint8* p, int count, int step)
+{
+    for (int i = 0; i < count; i += step)
+    {
+        p[i] = m_blendRow[p[i]];
+    }
+}
+
+uint8 Canvas::ditherIndex(const SDL_Color& color, int x, int y) const
+{
+    static const int cBayer[4][4] = {
+        { 0, 8, 2, 10 },
+        { 12, 4, 14, 6 },
+        { 3, 11, 1, 9 },
+        { 15, 7, 13, 5 },
+    };
+
+    // Offsets are centred on zero: (threshold + 0.5) / 16 - 0.5 of the spread.
+    const int offset = (2 * cBayer[y & 3][x & 3] + 1 - 16) * m_ditherSpread / 32;
+    return m_paletteLut.index((uint8)Util::Clamp(color.r + offset, 0, 255),
+        (uint8)Util::Clamp(color.g + offset, 0, 255),
+        (uint8)Util::Clamp(color.b + offset, 0, 255));
+}
+
+void Canvas::ditherSpan(int x, int y, int count)
+{
+    uint8* p = (uint8*)m_surface->pixels + y * m_surface->pitch + x;
+    const uint8* pattern = m_ditherRows[y & 3];
+
+    if (m_interlace == Interlace::Rows && ((y ^ m_parity) & 1) != 0)
+    {
+        return;
+    }
+    if (m_interlace == Interlace::Checkerboard)
+    {
+        for (int i = ((x + y) ^ m_parity) & 1; i < count; i += 2)
+        {
+            p[i] = pattern[(x + i) & 3];
+        }
+        return;
+    }
+
+    // Bytes up to a word boundary, then the pattern as words through the
+    // fill kernel, then the tail.
+    int i = 0;
+    for (; i < count && ((uintptr_t)(p + i) & 3) != 0; ++i)
+    {
+        p[i] = pattern[(x + i) & 3];
+    }
+
+    const int words = (count - i) / 4;
+    if (words > 0)
+    {
+        uint32 word;
+        memcpy(&word, &pattern[(x + i) & 3], sizeof(word));
+        m_kernels->fillSpan((uint32*)(p + i), words, word);
+        i += words * 4;
+    }
+
+    for (; i < count; ++i)
+    {
+        p[i] = pattern[(x + i) & 3];
+    }
+}
+
+SDL_Color Canvas::getPixelColor(int x, int y) const
+{
+    if (x < 0 || x >= m_renderWidth || y < 0 || y >= m_renderHeight)
+    {
+        const SDL_Color cBlack = { 0, 0, 0, 255 };
+        return cBlack;
+    }
+
+    return (this->*m_ops->read)(x, y);
+}
+
+template <typename Format>
+const typename Format::Pixel* Canvas::surfaceRow(const SDL_Surface* surface, int y)
+{
+    return (const typename Format::Pixel*)((const uint8*)surface->pixels + y * surface->pitch);
+}
+
+template <typename Format>
+typename Format::Pixel* Canvas::pixelAt(int x, int y) const
+{
+    return (typename Format::Pixel*)((uint8*)m_surface->pixels + y * m_surface->pitch) + x;
+}
+
+template <typename Format>
+void Canvas::spanImpl(int x, int y, int count)
+{
+    if (m_ditherSpan)
+    {
+        ditherSpan(x, y, count);
+        return;
+    }
+
+    if (m_interlace != Interlace::None)
+    {
+        interlacedSpan<Format>(x, y, count, m_drawPixel, m_drawAlpha);
+        return;
+    }
+
+    typename Format::Pixel* p = pixelAt<Format>(x, y);
+    if (m_blendRow)
+    {
+        // Only ever set on indexed canvases, where Pixel is uint8.
+        blendIndexed((uint8*)p, count, 1);
+    }
+    else if (m_drawAlpha != 255)
+    {
+        Format::blend(*m_kernels, p, count, m_drawPixel, m_drawAlpha);
+    }
+    else if (count == 1)
+    {
+        *p = (typename Format::Pixel)m_drawPixel;
+    }
+    else
+    {
+        Format::fill(*m_kernels, p, count, m_drawPixel);
+    }
+}
+
+template <typename Format>
+void Canvas::interlacedSpan(int x, int y, int count, uint32 value, uint32 alpha)
+{
+    typename Format::Pixel* p = pixelAt<Format>(x, y);
+    if (m_interlace == Interlace::Rows)
+    {
+        if (((y ^ m_parity) & 1) != 0)
+        {
+            return;
+        }
+
+        if (alpha != 255 && m_blendRow)
+        {
+            blendIndexed((uint8*)p, count, 1);
+        }
+        else if (alpha != 255)
+        {
+            Format::blend(*m_kernels, p, count, value, alpha);
+        }
+        else
+        {
+            Format::fill(*m_kernels, p, count, value);
+        }
+        return;
+    }
+
+    // Checkerboard: every other pixel, starting on the active one.
+    const int first = ((x + y) ^ m_parity) & 1;
+    if (alpha != 255 && m_blendRow)
+    {
+        blendIndexed((uint8*)p + first, count - first, 2);
+        return;
+    }
+    for (int i = first; i < count; i += 2)
+    {
+        if (alpha != 255)
+        {
+            Format::blend(*m_kernels, p + i, 1, value, alpha);
+        }
+        else
+        {
+            p[i] = (typename Format::Pixel)value;
+        }
+    }
+}
+
+template <typename Format>
+void Canvas::clearImpl(uint32 value)
+{
+    if (m_interlace == Interlace::None)
+    {
+        clearSurface<Format>(value);
+        return;
+    }
+
+    for (int y = 0; y < m_renderHeight; ++y)
+    {
+        interlacedSpan<Format>(0, y, m_renderWidth, value, 255);
+    }
+}
+
+template <typename Format>
+void Canvas::clearSurface(uint32 value)
+{
+    for (int y = 0; y < m_renderHeight; ++y)
+    {
+        Format::fill(*m_kernels, pixelAt<Format>(0, y), m_renderWidth, value);
+    }
+}
+
+template <>
+void Canvas::clearSurface<FormatARGB8888>(uint32 value)
+{
+    m_kernels->clear(m_surface->pixels, m_surface->pitch, m_renderWidth, m_renderHeight, value);
+}
+
+template <>
+void Canvas::clearSurface<FormatABGR8888>(uint32 value)
+{
+    m_kernels->clear(m_surface->pixels, m_surface->pitch, m_renderWidth, m_renderHeight, value);
+}
+
+template <typename Format>
+void Canvas::reconstructImpl()
+{
+    typedef typename Format::Pixel Pixel;
+
+    const int w = m_renderWidth;
+    const int h = m_renderHeight;
+    if (m_interlace == Interlace::Rows)
+    {
+        if (h < 2)
+        {
+            return;
+        }
+
+        for (int y = 1 - m_parity; y < h; y += 2)
+        {
+            const Pixel* above = pixelAt<Format>(0, y > 0 ? y - 1 : y + 1);
+            const Pixel* below = pixelAt<Format>(0, y + 1 < h ? y + 1 : y - 1);
+            Pixel* row = pixelAt<Format>(0, y);
+            for (int x = 0; x < w; ++x)
+            {
+                row[x] = Format::average(above[x], below[x]);
+            }
+        }
+        return;
+    }
+
+    if (w < 2)
+    {
+        return;
+    }
+
+    for (int y = 0; y < h; ++y)
+    {
+        Pixel* row = pixelAt<Format>(0, y);
+        for (int x = (y ^ m_parity ^ 1) & 1; x < w; x += 2)
+        {
+            Pixel left = row[x > 0 ? x - 1 : x + 1];
+            Pixel right = row[x + 1 < w ? x + 1 : x - 1];
+            row[x] = Format::average(left, right);
+        }
+    }
+}
+
+template <typename Format>
+void Canvas::uploadImpl(const FrameSource& source, void* pixels, int pitch, int scale, uint32* scratch, const ColorGrade* grade) const
+{
+    typedef typename Format::TexturePixel TexturePixel;
+
+    // Indexed surfaces grade their 256 palette entries instead of every pixel.
+    const uint32* palette = source.palette;
+    uint32 gradedPalette[256];
+    if (grade && Format::cFormat == PixelFormat::Indexed8)
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            gradedPalette[i] = grade->applyPixel(source.palette[i]);
+        }
+        palette = gradedPalette;
+    }
+
+    if (scale == 1)
+    {
+        for (int y = 0; y < source.height; ++y)
+        {
+            Format::upload(*m_kernels, (uint8*)pixels + y * pitch, surfaceRow<Format>(source.surface, y), source.width, palette, grade);
+        }
+        return;
+    }
+
+    // Each surface row is converted once, widened into the first texture row
+    // it covers and then copied down to the rest.
+    const int cRowBytes = source.width * scale * (int)sizeof(TexturePixel);
+    for (int y = 0; y < source.height; ++y)
+    {
+        const TexturePixel* src = (const TexturePixel*)surfaceRow<Format>(source.surface, y);
+        if (!Format::cUploadIsCopy || grade)
+        {
+            Format::upload(*m_kernels, scratch, surfaceRow<Format>(source.surface, y), source.width, palette, grade);
+            src = (const TexturePixel*)scratch;
+        }
+
+        uint8* row = (uint8*)pixels + y * scale * pitch;
+        upscaleRow(*m_kernels, (TexturePixel*)row, src, source.width, scale);
+        for (int i = 1; i < scale; ++i)
+        {
+            memcpy(row + i * pitch, row, cRowBytes);
+        }
+    }
+}
+
+template <typename Format>
+void Canvas::blitImpl(const Canvas& source, int x, int y, int sx, int sy, int width, int height)
+{
+    typedef typename Format::Pixel Pixel;
+
+    for (int row = 0; row < height; ++row)
+    {
+        Pixel* dst = pixelAt<Format>(x, y + row);
+        const Pixel* src = source.pixelAt<Format>(sx, sy + row);
+        if (!source.m_hasColorKey)
+        {
+            memcpy(dst, src, width * sizeof(Pixel));
+            continue;
+        }
+
+        const Pixel key = (Pixel)source.m_colorKeyPixel;
+        for (int i = 0; i < width; ++i)
+        {
+            if (src[i] != key)
+            {
+                dst[i] = src[i];
+            }
+        }
+    }
+}
+
+// Indexed copies go through the light map when one is set.
+template <>
+void Canvas::blitImpl<FormatIndexed8>(const Canvas& source, int x, int y, int sx, int sy, int width, int height)
+{
+    const uint8* light = m_lightMap;
+    const int key = source.m_hasColorKey ? (int)source.m_colorKeyPixel : -1;
+
+    for (int row = 0; row < height; ++row)
+    {
+        uint8* dst = pixelAt<FormatIndexed8>(x, y + row);
+        const uint8* src = source.pixelAt<FormatIndexed8>(sx, sy + row);
+        if (!light && key < 0)
+        {
+            memcpy(dst, src, width);
+            continue;
+        }
+
+        for (int i = 0; i < width; ++i)
+        {
+            if (src[i] != key)
+            {
+                dst[i] = light ? light[src[i]] : src[i];
+            }
+        }
+    }
+}
+
+template <typename Format>
+void Canvas::writeImpl(int x, int y, uint32 value)
+{
+    *pixelAt<Format>(x, y) = (typename Format::Pixel)value;
+}
+
+template <typename Format>
+SDL_Color Canvas::readImpl(int x, int y) const
+{
+    return Format::unpack(*pixelAt<Format>(x, y), m_paletteColors);
+}
+
+template <typename Format>
+uint32 Canvas::packImpl(const SDL_Color& color) const
+{
+    return Format::pack(color);
+}
+
+template <>
+uint32 Canvas::packImpl<FormatIndexed8>(const SDL_Color& color) const
+{
+    return (uint32)Palette::nearest(m_colorPalette, Util::Min(m_colorPaletteCount, 256), color);
+}
+
+template <typename Format>
+const Canvas::FormatOps* Canvas::formatOps()
+{
+    static const FormatOps ops = {
+        Format::cFormat,
+        Format::cBitsPerPixel,
+        Format::cRmask,
+        Format::cGmask,
+        Format::cBmask,
+        Format::cTextureFormat,
+        &Canvas::spanImpl<Format>,
+        &Canvas::clearImpl<Format>,
+        &Canvas::reconstructImpl<Format>,
+        &Canvas::uploadImpl<Format>,
+        &Canvas::blitImpl<Format>,
+        &Canvas::writeImpl<Format>,
+        &Canvas::readImpl<Format>,
+        &Canvas::packImpl<Format>,
+    };
+    return &ops;
+}
+
+const Canvas::FormatOps* Canvas::formatOps(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::ARGB8888: return formatOps<FormatARGB8888>();
+    case PixelFormat::RGB565: return formatOps<FormatRGB565>();
+    case PixelFormat::Indexed8: return formatOps<FormatIndexed8>();
+    default: return formatOps<FormatABGR8888>();
+    }
+}
+
+void Canvas::pointc(int x, int y, int count)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::PointC, { x, y, count }); }
+
+    Point p = mapPoint(x, y);
+    if (m_transform.axisAligned())
+    {
+        Point end = mapPoint(x + count, y);
+        plotSpan(p.x, p.y, end.x - p.x);
+    }
+    else if (count > 0)
+    {
+        Point end = mapPoint(x + count - 1, y);
+        rasterLine(p.x, p.y, end.x, end.y);
+    }
+}
+
+void Canvas::point(int x, int y)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::Point, { x, y }); }
+
+    Point p = mapPoint(x, y);
+    plotPoint(p.x, p.y);
+}
+
+void Canvas::points(int* data, int count)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->recordArray(DrawOp::Points, data, count * 2); }
+
+    for (int i = 0; i < count; ++i)
+    {
+        Point p = mapPoint(data[i * 2 + 0], data[i * 2 + 1]);
+        plotPoint(p.x, p.y);
+    }
+}
+
+void Canvas::vline(int x, int y1, int y2)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::VLine, { x, y1, y2 }); }
+
+    Point p1 = mapPoint(x, y1);
+    Point p2 = mapPoint(x, y2);
+    rasterLine(p1.x, p1.y, p2.x, p2.y);
+}
+
+void Canvas::hline(int y, int x1, int x2)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::HLine, { y, x1, x2 }); }
+
+    Point p1 = mapPoint(x1, y);
+    Point p2 = mapPoint(x2, y);
+    if (m_transform.axisAligned())
+    {
+        rasterHLine(p1.y, p1.x, p2.x);
+    }
+    else
+    {
+        rasterLine(p1.x, p1.y, p2.x, p2.y);
+    }
+}
+
+void Canvas::line(int x1, int y1, int x2, int y2)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::Line, { x1, y1, x2, y2 }); }
+
+    Point p1 = mapPoint(x1, y1);
+    Point p2 = mapPoint(x2, y2);
+    rasterLine(p1.x, p1.y, p2.x, p2.y);
+}
+
+void Canvas::lines(int* data, int segments)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->recordArray(DrawOp::Lines, data, (segments + 1) * 2); }
+
+    for (int i = 0; i < segments; ++i)
+    {
+        line(data[(i * 2) + 0], data[(i * 2) + 1],
+             data[((i + 1) * 2) + 0], data[((i + 1) * 2) + 1]);
+    }
+}
+
+void Canvas::rect(int x1, int y1, int x2, int y2)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::Rect, { x1, y1, x2, y2 }); }
+
+    line(x1, y1, x2, y1);
+    line(x2, y1, x2, y2);
+    line(x1, y1, x1, y2);
+    line(x1, y2, x2, y2);
+}
+
+void Canvas::fillRect(int x1, int y1, int x2, int y2)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::FillRect, { x1, y1, x2, y2 }); }
+
+    Point p1 = mapPoint(x1, y1);
+    Point p3 = mapPoint(x2, y2);
+    if (!m_transform.axisAligned())
+    {
+        Point p2 = mapPoint(x2, y1);
+        Point p4 = mapPoint(x1, y2);
+        rasterTriangle(p1.x, p1.y, p2.x, p2.y, p4.x, p4.y);
+        rasterTriangle(p2.x, p2.y, p3.x, p3.y, p4.x, p4.y);
+        return;
+    }
+
+    if (p1.y > p3.y) { Util::Swap(p1.y, p3.y); }
+    int top = Util::Max(p1.y, m_clip.top);
+    int bottom = Util::Min(p3.y, m_clip.bottom - 1);
+    for (int y = top; y <= bottom; ++y)
+    {
+        rasterHLine(y, p1.x, p3.x);
+    }
+}
+
+void Canvas::triangle(int x1, int y1, int x2, int y2, int x3, int y3)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::Triangle, { x1, y1, x2, y2, x3, y3 }); }
+
+    Point p1 = mapPoint(x1, y1);
+    Point p2 = mapPoint(x2, y2);
+    Point p3 = mapPoint(x3, y3);
+    rasterTriangle(p1.x, p1.y, p2.x, p2.y, p3.x, p3.y);
+}
+
+void Canvas::plotSpan(int x, int y, int count)
+{
+    if (y < m_clip.top || y >= m_clip.bottom)
+    {
+        return;
+    }
+
+    int x1 = Util::Max(x, m_clip.left);
+    int x2 = Util::Min(x + count, m_clip.right);
+    if (x1 < x2)
+    {
+        (this->*m_ops->span)(x1, y, x2 - x1);
+    }
+}
+
+void Canvas::plotPoint(int x, int y)
+{
+    if (x < m_clip.left || x >= m_clip.right || y < m_clip.top || y >= m_clip.bottom)
+    {
+        return;
+    }
+
+    (this->*m_ops->span)(x, y, 1);
+}
+
+void Canvas::rasterVLine(int x, int y1, int y2)
+{
+    if (x < m_clip.left || x >= m_clip.right)
+    {
+        return;
+    }
+
+    if (y1 > y2) { Util::Swap(y1, y2); }
+    y1 = Util::Max(y1, m_clip.top);
+    y2 = Util::Min(y2, m_clip.bottom - 1);
+    for (int y = y1; y <= y2; ++y)
+    {
+        (this->*m_ops->span)(x, y, 1);
+    }
+}
+
+void Canvas::rasterHLine(int y, int x1, int x2)
+{
+    if (x1 > x2) { Util::Swap(x1, x2); }
+    plotSpan(x1, y, x2 - x1);
+}
+
+void Canvas::rasterLine(int x1, int y1, int x2, int y2)
+{
+    int dx = abs(x2 - x1);
+    int dy = abs(y2 - y1);
+
+    if (dx == 0)
+    {
+        rasterVLine(x1, y1, y2);
+        return;
+    }
+    else if (dy == 0)
+    {
+        rasterHLine(y1, x1, x2);
+        return;
+    }
+
+    // Bresenham stepped along the major axis. After n steps the minor axis has
+    // moved ceil((n * minor - bias) / major) pixels, which lets the visible
+    // range of n be solved for before the loop; the pixels plotted are exactly
+    // those of the unclipped line that fall inside the scissor.
+    bool xMajor = dx > dy;
+    int major = xMajor ? dx : dy;
+    int minor = xMajor ? dy : dx;
+    int bias = major / 2;
+
+    int majorStart = xMajor ? x1 : y1;
+    int minorStart = xMajor ? y1 : x1;
+    int majorStep = (xMajor ? x1 < x2 : y1 < y2) ? 1 : -1;
+    int minorStep = (xMajor ? y1 < y2 : x1 < x2) ? 1 : -1;
+    int majorLo = xMajor ? m_clip.left : m_clip.top;
+    int majorHi = (xMajor ? m_clip.right : m_clip.bottom) - 1;
+    int minorLo = xMajor ? m_clip.top : m_clip.left;
+    int minorHi = (xMajor ? m_clip.bottom : m_clip.right) - 1;
+
+    // Steps (n) and minor advances (k) that stay inside the scissor.
+    int64 nFirst = majorStep > 0 ? majorLo - majorStart : majorStart - majorHi;
+    int64 nLast = majorStep > 0 ? majorHi - majorStart : majorStart - majorLo;
+    int64 kFirst = minorStep > 0 ? minorLo - minorStart : minorStart - minorHi;
+    int64 kLast = minorStep > 0 ? minorHi - minorStart : minorStart - minorLo;
+    nFirst = Util::Max<int64>(nFirst, 0);
+    nLast = Util::Min<int64>(nLast, major);
+    kFirst = Util::Max<int64>(kFirst, 0);
+    kLast = Util::Min<int64>(kLast, minor);
+    if (kFirst > kLast)
+    {
+        return;
+    }
+
+    if (kFirst > 0)
+    {
+        nFirst = Util::Max<int64>(nFirst, ((kFirst - 1) * major + bias) / minor + 1);
+    }
+    nLast = Util::Min<int64>(nLast, (kLast * major + bias) / minor);
+    if (nFirst > nLast)
+    {
+        return;
+    }
+
+    int n = (int)nFirst;
+    int64 t = (int64)n * minor - bias;
+    int k = (int)((t + major - 1) / major);
+    int remainder = (int)(t - (int64)k * major); // in (-major, 0]
+
+    int m = majorStart + n * majorStep;
+    int q = minorStart + k * minorStep;
+    for (int end = (int)nLast; n <= end; ++n)
+    {
+        if (xMajor)
+        {
+            (this->*m_ops->span)(m, q, 1);
+        }
+        else
+        {
+            (this->*m_ops->span)(q, m, 1);
+        }
+
+        m += majorStep;
+        remainder += minor;
+        if (remainder > 0)
+        {
+            remainder -= major;
+            q += minorStep;
+        }
+    }
+}
+
+void Canvas::rasterTriangle(int x1, int y1, int x2, int y2, int x3, int y3)
+{
+    Point points[3] = {
+        { x1, y1 },
+        { x2, y2 },
+        { x3, y3 },
+    };
+
+    Util::ArraySort<Point>(points, 3, [](const Point* p1, const Point* p2){ return p1->y < p2->y; });
+
+    if (points[1].y == points[2].y)
+    {
+        triangleFlatBottom(points);
+    }
+    else if (points[0].y == points[1].y)
+    {
+        triangleFlatTop(points);
+    }
+    else
+    {
+        int x4 = points[0].x + (int)roundf((f32)(points[1].y - points[0].y) / (f32)(points[2].y - points[0].y) * (f32)(points[2].x - points[0].x));
+        int y4 = points[1].y;
+
+        Point top[3] = {
+            points[0],
+            points[1],
+            { x4, y4 },
+        };
+
+        Point bottom[3] = {
+            points[1],
+            { x4, y4 },
+            points[2],
+        };
+
+        triangleFlatBottom(top);
+        triangleFlatTop(bottom);
+    }
+}
+
+void Canvas::triangleFlatBottom(Point* points)
+{
+    int topx = points[0].x;
+    int topy = points[0].y;
+    int y = points[1].y;
+    int leftx = points[1].x;
+    int rightx = points[2].x;
+
+    f32 mleft = (f32)(leftx - topx) / (f32)(y - topy);
+    f32 mright = (f32)(rightx - topx) / (f32)(y - topy);
+
+    f32 left = (f32)topx;
+    f32 right = (f32)topx;
+
+    for (int i = topy; i <= y; ++i)
+    {
+        rasterHLine(i, (int)left, (int)right);
+        left += mleft;
+        right += mright;
+    }
+}
+
+void Canvas::triangleFlatTop(Point* points)
+{
+    int botx = points[2].x;
+    int boty = points[2].y;
+    int y = points[0].y;
+    int leftx = points[0].x;
+    int rightx = points[1].x;
+
+    f32 mleft = (f32)(botx - leftx) / (f32)(boty - y);
+    f32 mright = (f32)(botx - rightx) / (f32)(boty - y);
+
+    f32 left = (f32)botx;
+    f32 right = (f32)botx;
+
+    for (int i = boty; i > y; --i)
+    {
+        rasterHLine(i, (int)roundf(left), (int)roundf(right));
+        left -= mleft;
+        right -= mright;
+    }
+}
+
+void Canvas::quad(int x1, int y1, int x2, int y2, int x3, int y3, int x4, int y4)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::Quad, { x1, y1, x2, y2, x3, y3, x4, y4 }); }
+
+    triangle(x1, y1, x2, y2, x4, y4);
+    triangle(x2, y2, x3, y3, x4, y4);
+}
+
+void Canvas::pushScissor(int x1, int y1, int x2, int y2)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::PushScissor, { x1, y1, x2, y2 }); }
+
+    assert(m_scissorDepth + 1 < cMaxStackDepth);
+
+    // Bounds of the transformed corners; the far edges are inclusive.
+    Point corners[4] = { mapPoint(x1, y1), mapPoint(x2, y1), mapPoint(x1, y2), mapPoint(x2, y2) };
+    ClipRect r = { corners[0].x, corners[0].y, corners[0].x, corners[0].y };
+    for (const Point& p : corners)
+    {
+        r.left = Util::Min(r.left, p.x);
+        r.top = Util::Min(r.top, p.y);
+        r.right = Util::Max(r.right, p.x);
+        r.bottom = Util::Max(r.bottom, p.y);
+    }
+
+    m_scissors[++m_scissorDepth] = m_clip;
+    m_clip.left = Util::Max(m_clip.left, r.left);
+    m_clip.top = Util::Max(m_clip.top, r.top);
+    m_clip.right = Util::Max(m_clip.left, Util::Min(m_clip.right, r.right + 1));
+    m_clip.bottom = Util::Max(m_clip.top, Util::Min(m_clip.bottom, r.bottom + 1));
+}
+
+void Canvas::popScissor()
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::PopScissor); }
+
+    assert(m_scissorDepth > 0);
+    m_clip = m_scissors[m_scissorDepth--];
+}
+
+void Canvas::pushTransform(const Transform& transform)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->recordTransform(transform); }
+
+    assert(m_transformDepth < cMaxStackDepth);
+    m_transforms[m_transformDepth++] = m_transform * transform;
+    updateTransform();
+}
+
+void Canvas::popTransform()
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::PopTransform); }
+
+    assert(m_transformDepth > 0);
+    --m_transformDepth;
+    updateTransform();
+}
+
+void Canvas::pushView(int x1, int y1, int x2, int y2)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::PushView, { x1, y1, x2, y2 }); }
+
+    pushScissor(x1, y1, x2, y2);
+    pushTransform(Transform::translation((f32)x1, (f32)y1));
+}
+
+void Canvas::popView()
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::PopView); }
+
+    popTransform();
+    popScissor();
+}
+
+void Canvas::resetView()
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::ResetView); }
+
+    m_scissorDepth = 0;
+    m_clip.left = 0;
+    m_clip.top = 0;
+    m_clip.right = m_renderWidth;
+    m_clip.bottom = m_renderHeight;
+
+    m_transformDepth = 0;
+    updateTransform();
+}
+
+void Canvas::view(int x1, int y1, int x2, int y2)
+{
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->record(DrawOp::View, { x1, y1, x2, y2 }); }
+
+    resetView();
+    rect(x1, y1, x2, y2);
+    pushView(x1, y1, x2, y2);
+}
+
+void Canvas::test()
+{
+    /*setDrawColor(255, 0, 0);
+    line(0, 0, 200, 200);*/
+
+    setDrawColor(0, 255, 0);
+    point(100, 10);
+    rect(5, 5, 25, 35);
+
+    setDrawColor(255, 0, 255);
+    quad(5, 50, 30, 55, 70, 90, 10, 105);
+
+    setDrawColor(255, 255, 0);
+    line(80, 100, 120, 70);
+
+    setDrawColor(0, 255, 255);
+    triangle(50, 5, 30, 20, 100, 80);
+}
\ No newline at end of file
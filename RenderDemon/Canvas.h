@@ -0,0 +1,386 @@
+#pragma once
+
+#include "Types.h"
+#include "Kernels.h"
+#include "PixelFormat.h"
+#include "Palette.h"
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <vector>
+
+class DrawCapture;
+class JobSystem;
+
+// Interlaced modes rasterize half the pixels each frame, alternating which
+// half on every present.
+enum class Interlace
+{
+    None,
+    Rows,         // even rows one frame, odd rows the next
+    Checkerboard, // pixels where (x + y) is even, then odd
+};
+
+// How the half that was not drawn this frame is filled in.
+enum class Reconstruct
+{
+    Copy,  // keep the previous frame's pixels
+    Blend, // average the freshly drawn neighbours
+};
+
+// How RGB colors are reduced to an indexed canvas's palette.
+enum class Dither
+{
+    None,           // nearest palette entry
+    Ordered,        // 4x4 Bayer offsets before the nearest match
+    FloydSteinberg, // error diffusion for converted blits, Ordered for drawing
+};
+
+// 2D affine transform: x' = a * x + c * y + tx, y' = b * x + d * y + ty.
+struct Transform
+{
+    f32 a, b, c, d, tx, ty;
+
+    static Transform identity() { return scaling(1.f, 1.f); }
+    static Transform translation(f32 x, f32 y) { Transform t = { 1.f, 0.f, 0.f, 1.f, x, y }; return t; }
+    static Transform scaling(f32 x, f32 y) { Transform t = { x, 0.f, 0.f, y, 0.f, 0.f }; return t; }
+    static Transform rotation(f32 radians);
+
+    // Applies other first, then this.
+    Transform operator*(const Transform& other) const;
+
+    bool axisAligned() const { return b == 0.f && c == 0.f; }
+    // Pure translation by whole pixels, which maps coordinates exactly.
+    bool integerTranslation() const;
+};
+
+// A software render target: one surface in any PixelFormat plus the
+// primitive API. Video adds a window to present into; a plain Canvas is an
+// offscreen layer that can be drawn once and blitted every frame.
+class Canvas
+{
+public:
+    Canvas(int width, int height, PixelFormat format = PixelFormat::ABGR8888);
+    virtual ~Canvas();
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    // Renders into the top-left percent of the surface in each axis. Callers
+    // keep using width() x height() coordinates; primitives are mapped to the
+    // render size when they are set up and present() stretches the result
+    // back over the window. Takes effect immediately, so call between frames.
+    void setRenderScale(int percent);
+    int renderScale() const { return m_renderScale; }
+    int renderWidth() const { return m_renderWidth; }
+    int renderHeight() const { return m_renderHeight; }
+
+    // Every span write, including clear(), skips pixels outside the active
+    // half; Video::present() reconstructs the other half and flips the parity.
+    void setInterlace(Interlace mode, Reconstruct reconstruct = Reconstruct::Copy);
+    Interlace interlace() const { return m_interlace; }
+    Reconstruct reconstruct() const { return m_reconstruct; }
+    PixelFormat format() const { return m_ops->format; }
+
+    // Records every subsequent public call until the capture has seen its frames.
+    void setCapture(DrawCapture* capture);
+
+    // Kernels are chosen from Kernels::active() at construction; this forces a level for testing.
+    void setKernelLevel(Kernels::Level level) { m_kernels = &Kernels::table(level); }
+    Kernels::Level kernelLevel() const { return m_kernels->level; }
+    const Kernels::Table& kernels() const { return *m_kernels; }
+
+    // Raw surface for whole-frame passes such as PostChain. Only the top-left
+    // renderWidth() x renderHeight() pixels hold the current frame.
+    void* pixels() const { return m_surface->pixels; }
+    int pitch() const { return m_surface->pitch; }
+
+    void setColorPalette(SDL_Color* palette, int count);
+    const SDL_Color* colorPalette() const { return m_colorPalette; }
+    int colorPaletteCount() const { return m_colorPaletteCount; }
+    // Palette index for an RGB color through the PaletteLut, which indexed
+    // canvases rebuild whenever the palette is set; others search it.
+    int paletteIndex(uint8 r, uint8 g, uint8 b) const;
+
+    // Only affects indexed canvases. Ordered dithering is built into the span
+    // writes: an RGB draw color becomes a 4x4 pattern of indices when it is
+    // set, so filling a span costs the same as a solid one. spread is the
+    // range of the Bayer offsets in 8-bit levels. Converted blits dither per
+    // pixel, or diffuse error with FloydSteinberg.
+    void setDither(Dither mode, int spread = 64);
+    Dither dither() const { return m_dither; }
+
+    // Scheduler for whole-canvas work such as diffused blits. Not owned;
+    // null (the default) does the work on the calling thread.
+    void setJobSystem(JobSystem* jobs) { m_jobs = jobs; }
+
+    void setDrawColor(uint8 r, uint8 g, uint8 b);
+    void setDrawColor(int index);
+    // 255 (the default) draws opaque; anything lower blends spans over the
+    // surface. Indexed canvases blend through the palette's translucency
+    // maps, with alpha rounded to 25, 50 or 75%.
+    void setDrawAlpha(uint8 alpha);
+    // Light level for indexed canvases, 0 (full bright) to
+    // ColorMaps::cLightLevels - 1. Shades the draw color and every pixel of
+    // blits through the palette's colormaps; other formats ignore it.
+    void setDrawLight(int level);
+    void setClearColor(uint8 r, uint8 g, uint8 b);
+    void setClearColor(int index);
+
+    void clear();
+
+    // Source pixels of this color are skipped when the canvas is blitted.
+    void setColorKey(uint8 r, uint8 g, uint8 b);
+    void setColorKey(int index);
+    void clearColorKey();
+
+    // Copies all of source to (x, y), clipped like any other primitive. When
+    // the formats match and no scaling is involved each row is a single
+    // memcpy, or a keyed copy if source has a color key; indexed canvases
+    // copy indices as they are. Blits are not recorded by captures.
+    void blit(const Canvas& source, int x, int y);
+
+    void pointc(int x, int y, int count);
+
+    void point(int x, int y);
+    void points(int* data, int count); // count is number of points so expects count * 2 ints
+    void vline(int x, int y1, int y2);
+    void hline(int y, int x1, int x2);
+    void line(int x1, int y1, int x2, int y2);
+    void lines(int* data, int segments);
+    void rect(int x1, int y1, int x2, int y2);
+    void fillRect(int x1, int y1, int x2, int y2);
+    void triangle(int x1, int y1, int x2, int y2, int x3, int y3);
+    void quad(int x1, int y1, int x2, int y2, int x3, int y3, int x4, int y4);
+
+    // Scissor stack. Rects are inclusive, given in the current transform's
+    // coordinates and intersected with the enclosing scissor. The result is
+    // kept as a surface rect that primitives are clipped against once, when
+    // they are set up.
+    void pushScissor(int x1, int y1, int x2, int y2);
+    void popScissor();
+
+    // Transform stack; a pushed transform applies before the enclosing ones.
+    // Primitives transform their vertices, so rotated rects become quads.
+    void pushTransform(const Transform& transform);
+    void popTransform();
+
+    // A panel: scissor to the rect and move the origin to its corner.
+    void pushView(int x1, int y1, int x2, int y2);
+    void popView();
+
+    // Drops every scissor and transform.
+    void resetView();
+    // Single-level panel kept for old callers and captures: resetView(),
+    // the border as rect(), then pushView().
+    void view(int x1, int y1, int x2, int y2);
+
+    void test();
+
+protected:
+    // Only the outermost public call is captured, so rect() records one op
+    // rather than the four line() calls it is built from.
+    class CaptureScope
+    {
+    public:
+        explicit CaptureScope(Canvas* canvas) : m_canvas(canvas) { ++canvas->m_captureDepth; }
+        ~CaptureScope() { --m_canvas->m_captureDepth; }
+
+        DrawCapture* get() const { return m_canvas->m_captureDepth == 1 ? m_canvas->m_capture : nullptr; }
+
+    private:
+        Canvas* m_canvas;
+    };
+
+    // What upload() reads: a finished surface plus the state it was drawn
+    // with, so it can be converted after the canvas has moved on.
+    struct FrameSource
+    {
+        const SDL_Surface* surface;
+        int width; // rendered area
+        int height;
+        const uint32* palette; // 256 ARGB entries
+    };
+
+    // Format-specific pieces of the drawing core, one instantiation per
+    // traits type in PixelFormat.h, selected once at construction.
+    struct FormatOps
+    {
+        PixelFormat format;
+        int bitsPerPixel;
+        uint32 rmask;
+        uint32 gmask;
+        uint32 bmask;
+        uint32 textureFormat;
+
+        void (Canvas::*span)(int x, int y, int count); // surface coordinates, already clipped
+        void (Canvas::*clear)(uint32 value);
+        void (Canvas::*reconstruct)();
+        void (Canvas::*upload)(const FrameSource& source, void* pixels, int pitch, int scale, uint32* row, const ColorGrade* grade) const;
+        void (Canvas::*blit)(const Canvas& source, int x, int y, int sx, int sy, int width, int height);
+        void (Canvas::*write)(int x, int y, uint32 value);
+        SDL_Color (Canvas::*read)(int x, int y) const;
+        uint32 (Canvas::*pack)(const SDL_Color& color) const;
+    };
+
+    // Reconstructs the undrawn interlace half if needed and flips the parity.
+    void endInterlacedFrame();
+
+    // Streaming texture format for upload().
+    uint32 textureFormat() const { return m_ops->textureFormat; }
+    // The current surface and render state.
+    FrameSource frameSource() const;
+    // Converts the rendered area of a frame into texture format, widened by
+    // scale and graded if grade is set; row must hold width() pixels when
+    // scale > 1. Only reads source and the kernel table, so a frame may be
+    // uploaded on another thread while the canvas draws the next one.
+    void upload(const FrameSource& source, void* pixels, int pitch, int scale, uint32* row, const ColorGrade* grade) const
+    {
+        (this->*m_ops->upload)(source, pixels, pitch, scale, row, grade);
+    }
+
+    // A surface like the one drawn into, owned by the caller.
+    SDL_Surface* createSurface() const;
+    // Draws into surface from now on and returns the previous one. Nothing
+    // is copied: the new surface keeps whatever it held.
+    SDL_Surface* swapSurface(SDL_Surface* surface);
+
+private:
+    Canvas(const Canvas&);
+    Canvas& operator=(const Canvas&);
+
+    // Views for ViewBatch draw into the parent's surface with its palette
+    // tables but keep their own draw state. They own neither; shareFrom()
+    // points them at the parent's current ones.
+    friend class ViewBatch;
+    explicit Canvas(const Canvas* parent);
+    void shareFrom(const Canvas& parent);
+
+    static const FormatOps* formatOps(PixelFormat format);
+    template <typename Format> static const FormatOps* formatOps();
+
+    template <typename Format> typename Format::Pixel* pixelAt(int x, int y) const;
+    template <typename Format> static const typename Format::Pixel* surfaceRow(const SDL_Surface* surface, int y);
+    template <typename Format> void spanImpl(int x, int y, int count);
+    template <typename Format> void interlacedSpan(int x, int y, int count, uint32 value, uint32 alpha);
+    template <typename Format> void clearImpl(uint32 value);
+    template <typename Format> void clearSurface(uint32 value);
+    template <typename Format> void reconstructImpl();
+    template <typename Format> void uploadImpl(const FrameSource& source, void* pixels, int pitch, int scale, uint32* row, const ColorGrade* grade) const;
+    template <typename Format> void blitImpl(const Canvas& source, int x, int y, int sx, int sy, int width, int height);
+    template <typename Format> void writeImpl(int x, int y, uint32 value);
+    template <typename Format> SDL_Color readImpl(int x, int y) const;
+    template <typename Format> uint32 packImpl(const SDL_Color& color) const;
+
+    void blitConverted(const Canvas& source, int x, int y);
+
+    // Caller coordinates to render coordinates.
+    int toRenderX(int x) const;
+    int toRenderY(int y) const;
+    // Applies the current transform, then maps to render coordinates.
+    Point mapPoint(int x, int y) const;
+    void updateTransform();
+
+    // Rasterizers in render (surface) coordinates. The public calls map their
+    // vertices once and these clip against the current scissor up front, so
+    // their loops only write.
+    void plotPoint(int x, int y);
+    void plotSpan(int x, int y, int count);
+    void rasterVLine(int x, int y1, int y2);
+    void rasterHLine(int y, int x1, int x2);
+    void rasterLine(int x1, int y1, int x2, int y2);
+    void rasterTriangle(int x1, int y1, int x2, int y2, int x3, int y3);
+
+    // index is the palette index the color came from, or -1 for RGB colors.
+    uint32 mapColor(const SDL_Color& color, int index) const;
+    void updateDrawPixel();
+    // Indexed translucent spans: p[i] = m_blendRow[p[i]] for every step-th pixel.
+    void blendIndexed(uint8* p, int count, int step);
+
+    // Ordered dithering: the palette index of color plus the Bayer offset at (x, y).
+    uint8 ditherIndex(const SDL_Color& color, int x, int y) const;
+    void ditherSpan(int x, int y, int count);
+    // Floyd-Steinberg over a converted blit, a row per band. Each row trails
+    // the one above by two pixels, since that is where its error comes from.
+    void blitDiffused(const Canvas& source, int rx1, int ry1, int rx2, int ry2, int x1, int y1, int x2, int y2);
+    static void diffuseRows(void* context, int begin, int end);
+    static void diffuseRow(void* context, int row);
+    SDL_Color getPixelColor(int x, int y) const;
+    
+    // drawing helpers
+    void triangleFlatBottom(Point* points);
+    void triangleFlatTop(Point* points);
+
+private:
+    int m_width;
+    int m_height;
+    int m_renderScale;
+    int m_renderWidth;
+    int m_renderHeight;
+    const FormatOps* m_ops;
+    SDL_Surface* m_surface;
+    SDL_Color m_drawColor;
+    uint8 m_drawAlpha;
+    int m_drawIndex;
+    uint32 m_drawPixel;
+    SDL_Color m_clearColor;
+    int m_clearIndex;
+    bool m_hasColorKey;
+    SDL_Color m_colorKey;
+    uint32 m_colorKeyPixel;
+
+    SDL_Color* m_defaultColorPalette;
+    SDL_Color* m_colorPalette;
+    int m_colorPaletteCount;
+    SDL_Color m_paletteColors[256];
+    uint32 m_paletteARGB[256];
+    uint32 m_paletteVersion; // bumped whenever the palette contents change
+    PaletteLut m_paletteLut; // indexed canvases only
+    ColorMaps* m_colorMaps; // indexed canvases only, rebuilt when the palette changes
+    int m_light;
+    const uint8* m_lightMap; // null at full brightness
+    const uint8* m_blendRow; // translucency row for the draw color, null when opaque
+
+    Interlace m_interlace;
+    Reconstruct m_reconstruct;
+    int m_parity;
+
+    // Surface rect, right and bottom exclusive.
+    struct ClipRect
+    {
+        int left, top, right, bottom;
+    };
+
+    static const int cMaxStackDepth = 16;
+    ClipRect m_scissors[cMaxStackDepth];
+    int m_scissorDepth;
+    ClipRect m_clip;
+    Transform m_transforms[cMaxStackDepth];
+    int m_transformDepth;
+    Transform m_transform;
+    bool m_translateOnly;
+    int m_translateX;
+    int m_translateY;
+
+    Dither m_dither;
+    int m_ditherSpread;
+    bool m_ditherSpan; // span writes use m_ditherRows
+    uint8 m_ditherRows[4][8]; // pattern indices, each row repeated so any 4 in a row can be read at once
+    std::vector<int16> m_diffuseError; // per-channel error, a padded row per surface row plus one
+    std::atomic<int>* m_diffuseProgress; // last column finished per row during blitDiffused()
+    JobSystem* m_jobs;
+
+    const Kernels::Table* m_kernels;
+
+    DrawCapture* m_capture;
+    int m_captureDepth;
+
+    const Canvas* m_parent; // views only
+};
+
+inline bool rgbEqual(const SDL_Color& c1, const SDL_Color& c2)
+{
+    return c1.r == c2.r &&
+        c1.g == c2.g &&
+        c1.b == c2.b;
+}
\ No newline at end of file
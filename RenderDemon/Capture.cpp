@@ -0,0 +1,398 @@
+#include "Capture.h"
+#include "Video.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    const uint8 cMagic[4] = { 'R', 'D', 'C', 'P' };
+    const uint8 cVersion = 1;
+
+    // Largest canvas side a replay will create.
+    const int cMaxSize = 16384;
+
+    // Fixed argument counts per op, -1 for ops with a length prefix.
+    const int cOpArgs[(int)DrawOp::Count] = {
+        0,  // FrameEnd
+        -1, // SetColorPalette
+        3,  // SetDrawColorRGB
+        1,  // SetDrawColorIndex
+        3,  // SetClearColorRGB
+        1,  // SetClearColorIndex
+        0,  // Clear
+        3,  // PointC
+        2,  // Point
+        -1, // Points
+        3,  // VLine
+        3,  // HLine
+        4,  // Line
+        -1, // Lines
+        4,  // Rect
+        4,  // FillRect
+        6,  // Triangle
+        8,  // Quad
+        0,  // ResetView
+        4,  // View
+        1,  // SetDrawAlpha
+        4,  // PushScissor
+        0,  // PopScissor
+        6,  // PushTransform
+        0,  // PopTransform
+        4,  // PushView
+        0,  // PopView
+        1,  // SetDrawLight
+    };
+
+    class Reader
+    {
+    public:
+        Reader(const uint8* data, size_t size) : m_data(data), m_size(size), m_pos(0), m_error(false) {}
+
+        bool done() const { return m_pos >= m_size || m_error; }
+        bool error() const { return m_error; }
+        size_t remaining() const { return m_pos < m_size ? m_size - m_pos : 0; }
+
+        uint8 readByte()
+        {
+            if (m_pos >= m_size)
+            {
+                m_error = true;
+                return 0;
+            }
+            return m_data[m_pos++];
+        }
+
+        int readInt()
+        {
+            uint32 value = 0;
+            int shift = 0;
+            uint8 byte;
+            do
+            {
+                byte = readByte();
+                value |= (uint32)(byte & 0x7F) << shift;
+                shift += 7;
+            } while ((byte & 0x80) && shift < 35 && !m_error);
+
+            return (int)(value >> 1) ^ -(int)(value & 1);
+        }
+
+    private:
+        const uint8* m_data;
+        size_t m_size;
+        size_t m_pos;
+        bool m_error;
+    };
+}
+
+DrawCapture::DrawCapture(const char* path, int width, int height, int frames)
+    : m_path(path),
+    m_width(width),
+    m_height(height),
+    m_frames(frames),
+    m_framesLeft(frames)
+{
+    // Reserve up front so recording does not show up as per-frame allocator traffic.
+    m_buffer.reserve(64 * 1024);
+
+    m_buffer.insert(m_buffer.end(), cMagic, cMagic + 4);
+    writeByte(cVersion);
+    writeInt(width);
+    writeInt(height);
+    writeInt(frames);
+}
+
+DrawCapture::~DrawCapture()
+{
+    if (active())
+    {
+        SDL_Log("capture: stopped after %d of %d frames", m_frames - m_framesLeft, m_frames);
+        flush();
+    }
+}
+
+void DrawCapture::writeByte(uint8 value)
+{
+    m_buffer.push_back(value);
+}
+
+void DrawCapture::writeInt(int value)
+{
+    uint32 zigzag = ((uint32)value << 1) ^ (uint32)(value >> 31);
+    while (zigzag >= 0x80)
+    {
+        writeByte((uint8)(zigzag | 0x80));
+        zigzag >>= 7;
+    }
+    writeByte((uint8)zigzag);
+}
+
+void DrawCapture::record(DrawOp op)
+{
+    if (!active()) { return; }
+    writeByte((uint8)op);
+}
+
+void DrawCapture::record(DrawOp op, std::initializer_list<int> args)
+{
+    if (!active()) { return; }
+    writeByte((uint8)op);
+    for (int arg : args)
+    {
+        writeInt(arg);
+    }
+}
+
+void DrawCapture::recordArray(DrawOp op, const int* data, int count)
+{
+    if (!active()) { return; }
+    writeByte((uint8)op);
+    writeInt(count);
+    for (int i = 0; i < count; ++i)
+    {
+        writeInt(data[i]);
+    }
+}
+
+void DrawCapture::recordPalette(const SDL_Color* palette, int count)
+{
+    if (!active()) { return; }
+    writeByte((uint8)DrawOp::SetColorPalette);
+    writeInt(count);
+    for (int i = 0; i < count; ++i)
+    {
+        writeByte(palette[i].r);
+        writeByte(palette[i].g);
+        writeByte(palette[i].b);
+        writeByte(palette[i].a);
+    }
+}
+
+void DrawCapture::recordTransform(const Transform& transform)
+{
+    if (!active()) { return; }
+    writeByte((uint8)DrawOp::PushTransform);
+    const f32 values[6] = { transform.a, transform.b, transform.c, transform.d, transform.tx, transform.ty };
+    for (f32 value : values)
+    {
+        int bits;
+        memcpy(&bits, &value, sizeof(bits));
+        writeInt(bits);
+    }
+}
+
+void DrawCapture::endFrame()
+{
+    if (!active()) { return; }
+    writeByte((uint8)DrawOp::FrameEnd);
+
+    if (--m_framesLeft == 0)
+    {
+        if (flush())
+        {
+            SDL_Log("capture: wrote %d frames (%u bytes) to %s", m_frames, (uint32)m_buffer.size(), m_path);
+        }
+    }
+}
+
+bool DrawCapture::flush()
+{
+    FILE* file = fopen(m_path, "wb");
+    if (!file)
+    {
+        SDL_Log("capture: could not open %s for writing", m_path);
+        return false;
+    }
+
+    size_t written = fwrite(m_buffer.data(), 1, m_buffer.size(), file);
+    fclose(file);
+    return written == m_buffer.size();
+}
+
+DrawReplay::DrawReplay()
+    : m_width(0),
+    m_height(0),
+    m_frames(0),
+    m_commands(0)
+{
+}
+
+bool DrawReplay::load(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        SDL_Log("replay: could not open %s", path);
+        return false;
+    }
+
+    std::vector<uint8> data;
+    uint8 chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        data.insert(data.end(), chunk, chunk + read);
+    }
+    fclose(file);
+
+    if (data.size() < 5 || !std::equal(cMagic, cMagic + 4, data.begin()) || data[4] != cVersion)
+    {
+        SDL_Log("replay: %s is not a version %d capture", path, cVersion);
+        return false;
+    }
+
+    Reader reader(data.data() + 5, data.size() - 5);
+    m_width = reader.readInt();
+    m_height = reader.readInt();
+    reader.readInt(); // requested frame count; frames are counted from the stream
+    if (m_width <= 0 || m_height <= 0 || m_width > cMaxSize || m_height > cMaxSize)
+    {
+        SDL_Log("replay: bad size %dx%d in %s", m_width, m_height, path);
+        return false;
+    }
+
+    m_frames = 0;
+    m_commands = 0;
+    m_stream.clear();
+    m_palettes.clear();
+
+    // Captures are seeded with a palette, so no index is valid before one.
+    int paletteCount = 0;
+
+    while (!reader.done())
+    {
+        uint8 op = reader.readByte();
+        if (op >= (uint8)DrawOp::Count)
+        {
+            SDL_Log("replay: bad op %d in %s", op, path);
+            return false;
+        }
+
+        m_stream.push_back(op);
+
+        if (op == (uint8)DrawOp::SetColorPalette)
+        {
+            // Counts come from the file: each entry takes four bytes.
+            int count = reader.readInt();
+            if (count < 0 || count > 256 || (size_t)count * 4 > reader.remaining())
+            {
+                SDL_Log("replay: bad palette size %d in %s", count, path);
+                return false;
+            }
+
+            std::vector<SDL_Color> palette(count);
+            for (int i = 0; i < count; ++i)
+            {
+                palette[i].r = reader.readByte();
+                palette[i].g = reader.readByte();
+                palette[i].b = reader.readByte();
+                palette[i].a = reader.readByte();
+            }
+            m_stream.push_back(1);
+            m_stream.push_back((int)m_palettes.size());
+            m_palettes.push_back(palette);
+            paletteCount = count;
+        }
+        else
+        {
+            // Every argument takes at least a byte.
+            int count = cOpArgs[op] >= 0 ? cOpArgs[op] : reader.readInt();
+            if (count < 0 || (size_t)count > reader.remaining())
+            {
+                SDL_Log("replay: bad argument count %d in %s", count, path);
+                return false;
+            }
+            m_stream.push_back(count);
+            for (int i = 0; i < count; ++i)
+            {
+                m_stream.push_back(reader.readInt());
+            }
+
+            if (!reader.error() && (op == (uint8)DrawOp::SetDrawColorIndex || op == (uint8)DrawOp::SetClearColorIndex) &&
+                (m_stream.back() < 0 || m_stream.back() >= paletteCount))
+            {
+                SDL_Log("replay: color index %d outside a palette of %d in %s", m_stream.back(), paletteCount, path);
+                return false;
+            }
+        }
+
+        if (op == (uint8)DrawOp::FrameEnd)
+        {
+            ++m_frames;
+        }
+        else
+        {
+            ++m_commands;
+        }
+    }
+
+    if (reader.error())
+    {
+        SDL_Log("replay: %s is truncated", path);
+        return false;
+    }
+    if (m_frames == 0)
+    {
+        SDL_Log("replay: %s has no frames", path);
+        return false;
+    }
+
+    return true;
+}
+
+void DrawReplay::run(Video* ctx)
+{
+    int* s = m_stream.data();
+    int* end = s + m_stream.size();
+
+    while (s < end)
+    {
+        DrawOp op = (DrawOp)s[0];
+        int count = s[1];
+        int* a = s + 2;
+        s = a + count;
+
+        switch (op)
+        {
+        case DrawOp::FrameEnd: ctx->present(); break;
+        case DrawOp::SetColorPalette:
+            ctx->setColorPalette(m_palettes[a[0]].data(), (int)m_palettes[a[0]].size());
+            break;
+        case DrawOp::SetDrawColorRGB: ctx->setDrawColor((uint8)a[0], (uint8)a[1], (uint8)a[2]); break;
+        case DrawOp::SetDrawColorIndex: ctx->setDrawColor(a[0]); break;
+        case DrawOp::SetDrawAlpha: ctx->setDrawAlpha((uint8)a[0]); break;
+        case DrawOp::SetDrawLight: ctx->setDrawLight(a[0]); break;
+        case DrawOp::SetClearColorRGB: ctx->setClearColor((uint8)a[0], (uint8)a[1], (uint8)a[2]); break;
+        case DrawOp::SetClearColorIndex: ctx->setClearColor(a[0]); break;
+        case DrawOp::Clear: ctx->clear(); break;
+        case DrawOp::PointC: ctx->pointc(a[0], a[1], a[2]); break;
+        case DrawOp::Point: ctx->point(a[0], a[1]); break;
+        case DrawOp::Points: ctx->points(a, count / 2); break;
+        case DrawOp::VLine: ctx->vline(a[0], a[1], a[2]); break;
+        case DrawOp::HLine: ctx->hline(a[0], a[1], a[2]); break;
+        case DrawOp::Line: ctx->line(a[0], a[1], a[2], a[3]); break;
+        case DrawOp::Lines: ctx->lines(a, count / 2 - 1); break;
+        case DrawOp::Rect: ctx->rect(a[0], a[1], a[2], a[3]); break;
+        case DrawOp::FillRect: ctx->fillRect(a[0], a[1], a[2], a[3]); break;
+        case DrawOp::Triangle: ctx->triangle(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+        case DrawOp::Quad: ctx->quad(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]); break;
+        case DrawOp::ResetView: ctx->resetView(); break;
+        case DrawOp::View: ctx->view(a[0], a[1], a[2], a[3]); break;
+        case DrawOp::PushScissor: ctx->pushScissor(a[0], a[1], a[2], a[3]); break;
+        case DrawOp::PopScissor: ctx->popScissor(); break;
+        case DrawOp::PushTransform:
+        {
+            Transform transform;
+            memcpy(&transform, a, sizeof(transform));
+            ctx->pushTransform(transform);
+            break;
+        }
+        case DrawOp::PopTransform: ctx->popTransform(); break;
+        case DrawOp::PushView: ctx->pushView(a[0], a[1], a[2], a[3]); break;
+        case DrawOp::PopView: ctx->popView(); break;
+        default: break;
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Types.h"
+
+#include <SDL2/SDL.h>
+#include <initializer_list>
+#include <vector>
+
+class Video;
+struct Transform;
+
+// Every public Video call maps to one op. Ops are serialized as a single
+// byte followed by zigzag varint arguments, which keeps typical frames to a
+// few hundred bytes.
+enum class DrawOp : uint8
+{
+    FrameEnd,
+    SetColorPalette,
+    SetDrawColorRGB,
+    SetDrawColorIndex,
+    SetClearColorRGB,
+    SetClearColorIndex,
+    Clear,
+    PointC,
+    Point,
+    Points,
+    VLine,
+    HLine,
+    Line,
+    Lines,
+    Rect,
+    FillRect,
+    Triangle,
+    Quad,
+    ResetView,
+    View,
+    SetDrawAlpha,
+    PushScissor,
+    PopScissor,
+    PushTransform, // six floats stored as their bit patterns
+    PopTransform,
+    PushView,
+    PopView,
+    SetDrawLight,
+    Count,
+};
+
+// Records Video calls for a fixed number of frames and writes them to disk
+// once the last frame has been presented.
+class DrawCapture
+{
+public:
+    DrawCapture(const char* path, int width, int height, int frames);
+    ~DrawCapture();
+
+    bool active() const { return m_framesLeft > 0; }
+
+    void record(DrawOp op);
+    void record(DrawOp op, std::initializer_list<int> args);
+    void recordArray(DrawOp op, const int* data, int count);
+    void recordPalette(const SDL_Color* palette, int count);
+    void recordTransform(const Transform& transform);
+    void endFrame();
+
+private:
+    DrawCapture(const DrawCapture&);
+    DrawCapture& operator=(const DrawCapture&);
+
+    void writeByte(uint8 value);
+    void writeInt(int value);
+    bool flush();
+
+    const char* m_path;
+    int m_width;
+    int m_height;
+    int m_frames;
+    int m_framesLeft;
+    std::vector<uint8> m_buffer;
+};
+
+// Loads a capture file and re-executes it against a Video context.
+class DrawReplay
+{
+public:
+    DrawReplay();
+
+    bool load(const char* path);
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int frames() const { return m_frames; }
+    int commands() const { return m_commands; }
+
+    // Executes every captured frame once. Frame ends call Video::present.
+    void run(Video* ctx);
+
+private:
+    int m_width;
+    int m_height;
+    int m_frames;
+    int m_commands;
+
+    // Decoded stream: op, argument count, arguments...
+    std::vector<int> m_stream;
+    std::vector<std::vector<SDL_Color>> m_palettes;
+};
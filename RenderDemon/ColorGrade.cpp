@@ -0,0 +1,209 @@
+#include "ColorGrade.h"
+#include "Memory.h"
+
+#include <SDL2/SDL.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+ColorGrade::ColorGrade()
+    : m_mode(Mode::None),
+    m_cubeSize(0)
+{
+}
+
+void ColorGrade::reset()
+{
+    m_mode = Mode::None;
+}
+
+void ColorGrade::setChannels(const uint8* r, const uint8* g, const uint8* b)
+{
+    memcpy(m_curves[0], r, 256);
+    memcpy(m_curves[1], g, 256);
+    memcpy(m_curves[2], b, 256);
+    m_mode = Mode::Channel;
+    bakeTables();
+}
+
+void ColorGrade::setGamma(f32 gamma)
+{
+    uint8 curve[256];
+    for (int i = 0; i < 256; ++i)
+    {
+        curve[i] = (uint8)floorf(255.f * powf(i / 255.f, 1.f / gamma) + 0.5f);
+    }
+    setChannels(curve, curve, curve);
+}
+
+void ColorGrade::setCube(int size, const uint8* rgb)
+{
+    m_cubeSize = size;
+    m_cube.assign(rgb, rgb + size * size * size * 3);
+    m_mode = Mode::Cube;
+    bakeTables();
+}
+
+bool ColorGrade::loadCube(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+    {
+        SDL_Log("grade: could not open %s", path);
+        return false;
+    }
+
+    int size = 0;
+    std::vector<uint8> rgb;
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        f32 r, g, b;
+        if (sscanf(line, "LUT_3D_SIZE %d", &size) == 1)
+        {
+            rgb.reserve(size * size * size * 3);
+        }
+        else if (size > 0 && sscanf(line, "%f %f %f", &r, &g, &b) == 3)
+        {
+            const f32 values[3] = { r, g, b };
+            for (f32 v : values)
+            {
+                v = v < 0.f ? 0.f : (v > 1.f ? 1.f : v);
+                rgb.push_back((uint8)floorf(v * 255.f + 0.5f));
+            }
+        }
+    }
+    fclose(file);
+
+    if (size < 2 || (int)rgb.size() != size * size * size * 3)
+    {
+        SDL_Log("grade: %s is not a 3D LUT", path);
+        return false;
+    }
+
+    setCube(size, rgb.data());
+    return true;
+}
+
+void ColorGrade::gradeRGB(int r, int g, int b, uint8* out) const
+{
+    if (m_mode == Mode::Channel)
+    {
+        out[0] = m_curves[0][r];
+        out[1] = m_curves[1][g];
+        out[2] = m_curves[2][b];
+        return;
+    }
+
+    // Trilinear interpolation in 8-bit fixed point.
+    const int n = m_cubeSize - 1;
+    int pos[3] = { r * n, g * n, b * n };
+    int base[3], frac[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        base[i] = pos[i] / 255;
+        frac[i] = ((pos[i] % 255) * 256 + 127) / 255;
+        if (base[i] == n)
+        {
+            base[i] = n - 1;
+            frac[i] = 256;
+        }
+    }
+
+    const int cStride[3] = { 3, 3 * m_cubeSize, 3 * m_cubeSize * m_cubeSize };
+    const uint8* corner = &m_cube[base[0] * cStride[0] + base[1] * cStride[1] + base[2] * cStride[2]];
+    for (int c = 0; c < 3; ++c)
+    {
+        int v[2][2];
+        for (int z = 0; z < 2; ++z)
+        {
+            for (int y = 0; y < 2; ++y)
+            {
+                const uint8* p = corner + z * cStride[2] + y * cStride[1] + c;
+                v[z][y] = p[0] * (256 - frac[0]) + p[cStride[0]] * frac[0];
+            }
+        }
+        int yz0 = (v[0][0] * (256 - frac[1]) + v[0][1] * frac[1]) >> 8;
+        int yz1 = (v[1][0] * (256 - frac[1]) + v[1][1] * frac[1]) >> 8;
+        out[c] = (uint8)(((yz0 * (256 - frac[2]) + yz1 * frac[2]) + (1 << 15)) >> 16);
+    }
+}
+
+void ColorGrade::bakeTables()
+{
+    Memory::Scope memoryScope(Memory::Tag::Video);
+
+    if (m_mode == Mode::Channel)
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            m_argbTables[i] = m_curves[2][i];
+            m_argbTables[256 + i] = (uint32)m_curves[1][i] << 8;
+            m_argbTables[512 + i] = (uint32)m_curves[0][i] << 16;
+            m_abgrTables[i] = (uint32)m_curves[0][i] << 16;
+            m_abgrTables[256 + i] = (uint32)m_curves[1][i] << 8;
+            m_abgrTables[512 + i] = m_curves[2][i];
+        }
+    }
+
+    else
+    {
+        // Each cell is graded at the value its six bits expand to, like the
+        // 5-6-5 table below.
+        const int cSteps = 64;
+        m_argbCube.resize(cSteps * cSteps * cSteps);
+        m_abgrCube.resize(cSteps * cSteps * cSteps);
+        for (int z = 0; z < cSteps; ++z)
+        {
+            for (int y = 0; y < cSteps; ++y)
+            {
+                for (int x = 0; x < cSteps; ++x)
+                {
+                    const int index = (z * cSteps + y) * cSteps + x;
+                    uint8 out[3];
+                    gradeRGB((z << 2) | (z >> 4), (y << 2) | (y >> 4), (x << 2) | (x >> 4), out);
+                    m_argbCube[index] = 0xFF000000 | ((uint32)out[0] << 16) | ((uint32)out[1] << 8) | out[2];
+                    gradeRGB((x << 2) | (x >> 4), (y << 2) | (y >> 4), (z << 2) | (z >> 4), out);
+                    m_abgrCube[index] = 0xFF000000 | ((uint32)out[0] << 16) | ((uint32)out[1] << 8) | out[2];
+                }
+            }
+        }
+    }
+
+    m_table565.resize(65536);
+    for (int i = 0; i < 65536; ++i)
+    {
+        int r = (i >> 11) & 0x1F, g = (i >> 5) & 0x3F, b = i & 0x1F;
+        uint8 out[3];
+        gradeRGB((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), out);
+        m_table565[i] = (uint16)(((out[0] >> 3) << 11) | ((out[1] >> 2) << 5) | (out[2] >> 3));
+    }
+}
+
+void ColorGrade::apply(const Kernels::Table& k, uint32* dst, const uint32* src, int count, bool redLow) const
+{
+    if (m_mode == Mode::Channel)
+    {
+        k.applyLut(dst, src, count, redLow ? m_abgrTables : m_argbTables);
+    }
+    else
+    {
+        k.applyCube(dst, src, count, redLow ? m_abgrCube.data() : m_argbCube.data());
+    }
+}
+
+void ColorGrade::apply565(uint16* dst, const uint16* src, int count) const
+{
+    const uint16* table = m_table565.data();
+    for (int i = 0; i < count; ++i)
+    {
+        dst[i] = table[src[i]];
+    }
+}
+
+uint32 ColorGrade::applyPixel(uint32 argb) const
+{
+    uint8 out[3];
+    gradeRGB((argb >> 16) & 0xFF, (argb >> 8) & 0xFF, argb & 0xFF, out);
+    return (argb & 0xFF000000) | ((uint32)out[0] << 16) | ((uint32)out[1] << 8) | out[2];
+}
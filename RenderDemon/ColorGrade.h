@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Types.h"
+#include "Kernels.h"
+
+#include <vector>
+
+// Color correction applied by Video::present() while it converts the surface
+// for upload, so grading costs a lookup per pixel instead of a redraw.
+// Either three per-channel curves or a 3D LUT; both are baked into
+// format-specific tables when set, so present() never builds anything. A
+// cube grades 32-bit pixels through a 64^3 table, so their low two bits per
+// channel are dropped; palettes are graded exactly.
+class ColorGrade
+{
+public:
+    enum class Mode
+    {
+        None,
+        Channel,
+        Cube,
+    };
+
+    ColorGrade();
+
+    Mode mode() const { return m_mode; }
+    void reset();
+
+    // 256-entry curves per channel.
+    void setChannels(const uint8* r, const uint8* g, const uint8* b);
+    // out = 255 * (in / 255) ^ (1 / gamma) on every channel.
+    void setGamma(f32 gamma);
+    // size^3 RGB triplets with red varying fastest, as in .cube files.
+    void setCube(int size, const uint8* rgb);
+    // Reads an Adobe/Resolve .cube 3D LUT.
+    bool loadCube(const char* path);
+
+    // Grades 32-bit pixels into ARGB8888. redLow says whether R is in the
+    // low byte of src (ABGR8888) or the third (ARGB8888).
+    void apply(const Kernels::Table& k, uint32* dst, const uint32* src, int count, bool redLow) const;
+    void apply565(uint16* dst, const uint16* src, int count) const;
+    // One ARGB8888 color, e.g. a palette entry.
+    uint32 applyPixel(uint32 argb) const;
+
+private:
+    void gradeRGB(int r, int g, int b, uint8* out) const;
+    void bakeTables();
+
+    Mode m_mode;
+    uint8 m_curves[3][256];
+    int m_cubeSize;
+    std::vector<uint8> m_cube;
+
+    // applyLut tables for each source byte order, with outputs pre-shifted.
+    uint32 m_argbTables[3 * 256];
+    uint32 m_abgrTables[3 * 256];
+    std::vector<uint16> m_table565;
+    // applyCube tables for each source byte order, ARGB8888 out.
+    std::vector<uint32> m_argbCube;
+    std::vector<uint32> m_abgrCube;
+};
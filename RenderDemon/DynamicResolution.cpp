@@ -0,0 +1,60 @@
+#include "DynamicResolution.h"
+#include "Util.h"
+
+namespace
+{
+    const f64 cSmoothing = 0.1;
+    const int cSettleFrames = 10;   // samples after a change before acting again
+    const int cDownFrames = 5;      // consecutive frames over budget
+    const int cUpFrames = 60;       // consecutive frames with headroom
+    const f64 cUpHeadroom = 0.85;   // next step must fit in this much of the budget
+}
+
+ResolutionController::ResolutionController(f64 targetMs, int minPercent, int stepPercent)
+    : m_targetMs(targetMs),
+    m_minPercent(Util::Max(1, Util::Min(minPercent, 100))),
+    m_stepPercent(Util::Max(1, stepPercent)),
+    m_percent(100),
+    m_averageMs(0.0),
+    m_samples(0),
+    m_overFrames(0),
+    m_underFrames(0),
+    m_changes(0)
+{
+}
+
+int ResolutionController::update(f64 renderMs)
+{
+    m_averageMs = m_samples == 0 ? renderMs : m_averageMs + (renderMs - m_averageMs) * cSmoothing;
+    if (++m_samples < cSettleFrames)
+    {
+        return m_percent;
+    }
+
+    m_overFrames = m_averageMs > m_targetMs ? m_overFrames + 1 : 0;
+
+    // Raster cost scales with pixel count, i.e. with the square of the scale.
+    f64 next = (f64)Util::Min(m_percent + m_stepPercent, 100) / (f64)m_percent;
+    bool fits = m_averageMs * next * next < m_targetMs * cUpHeadroom;
+    m_underFrames = fits ? m_underFrames + 1 : 0;
+
+    if (m_overFrames >= cDownFrames && m_percent > m_minPercent)
+    {
+        change(Util::Max(m_percent - m_stepPercent, m_minPercent));
+    }
+    else if (m_underFrames >= cUpFrames && m_percent < 100)
+    {
+        change(Util::Min(m_percent + m_stepPercent, 100));
+    }
+
+    return m_percent;
+}
+
+void ResolutionController::change(int percent)
+{
+    m_percent = percent;
+    m_samples = 0;
+    m_overFrames = 0;
+    m_underFrames = 0;
+    ++m_changes;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Types.h"
+
+// Picks Video's render scale from measured render times. The scale drops a
+// step after the average stays over budget for a few frames and only climbs
+// back after a longer run where the next step up is predicted to fit, so it
+// settles instead of oscillating between two steps.
+class ResolutionController
+{
+public:
+    ResolutionController(f64 targetMs, int minPercent = 50, int stepPercent = 10);
+
+    // Feeds one frame's render time and returns the scale for the next frame.
+    int update(f64 renderMs);
+
+    int percent() const { return m_percent; }
+    int changes() const { return m_changes; }
+
+private:
+    void change(int percent);
+
+    f64 m_targetMs;
+    int m_minPercent;
+    int m_stepPercent;
+
+    int m_percent;
+    f64 m_averageMs;
+    int m_samples;
+    int m_overFrames;
+    int m_underFrames;
+    int m_changes;
+};
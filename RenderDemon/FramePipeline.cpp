@@ -0,0 +1,41 @@
+#include "FramePipeline.h"
+
+#include <cassert>
+
+FramePipeline::FramePipeline(JobSystem& jobs, StepFunction step, void* context)
+    : m_jobs(&jobs),
+    m_step(step),
+    m_context(context),
+    m_frame(0)
+{
+}
+
+FramePipeline::~FramePipeline()
+{
+    finish();
+}
+
+void FramePipeline::submit(uint64 frame)
+{
+    assert(m_counter.done());
+    m_frame = frame;
+    m_jobs->run(runStep, this, &m_counter);
+}
+
+void FramePipeline::wait(uint64 frame)
+{
+    assert(frame == m_frame);
+    (void)frame;
+    m_jobs->wait(m_counter);
+}
+
+void FramePipeline::finish()
+{
+    m_jobs->wait(m_counter);
+}
+
+void FramePipeline::runStep(void* context)
+{
+    FramePipeline* pipeline = (FramePipeline*)context;
+    pipeline->m_step(pipeline->m_context, pipeline->m_frame);
+}
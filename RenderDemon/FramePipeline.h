@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Types.h"
+#include "Jobs.h"
+
+// Runs the simulation step for frame N + 1 as a job while the caller
+// rasterizes frame N. The caller double-buffers whatever the step
+// publishes: step(N) writes slot N & 1 and the renderer reads the other one.
+// The step is handed over through the job system's deques and a counter,
+// so neither side takes a lock; waiting for it runs other queued jobs.
+class FramePipeline
+{
+public:
+    typedef void (*StepFunction)(void* context, uint64 frame);
+
+    // The job system is not owned and must outlive the pipeline.
+    FramePipeline(JobSystem& jobs, StepFunction step, void* context);
+    ~FramePipeline();
+
+    // Queues step(context, frame). At most one step is in flight: the
+    // previous frame must already have been waited on.
+    void submit(uint64 frame);
+
+    // Returns once step(frame) has finished; everything it wrote is then
+    // visible to the caller.
+    void wait(uint64 frame);
+
+    // Waits for whatever was last submitted.
+    void finish();
+
+private:
+    FramePipeline(const FramePipeline&);
+    FramePipeline& operator=(const FramePipeline&);
+
+    static void runStep(void* context);
+
+    JobSystem* m_jobs;
+    StepFunction m_step;
+    void* m_context;
+    uint64 m_frame; // the step in flight, or the last one
+    JobCounter m_counter;
+};
@@ -1,28 +1,79 @@
 #pragma once
 
+#include "Types.h"
+#include "InputStamp.h"
+
 #include <SDL2/SDL.h>
 #include <algorithm>
+#include <iterator>
 
+// Key state as bitsets, one bit per scancode. update() latches a frame:
+// edges since the previous update are found a word at a time, and the
+// stamp of the earliest event since then becomes the frame's.
 class InputManager
 {
 public:
+    static const int cWords = (SDL_NUM_SCANCODES + 63) / 64;
+
     InputManager() 
     {
-        std::fill(std::begin(m_oldStates), std::end(m_oldStates), false);
-        std::fill(std::begin(m_newStates), std::end(m_newStates), false);
+        std::fill(std::begin(m_held), std::end(m_held), 0);
+        std::fill(std::begin(m_previous), std::end(m_previous), 0);
+        std::fill(std::begin(m_pressed), std::end(m_pressed), 0);
+        std::fill(std::begin(m_released), std::end(m_released), 0);
+        m_pending = m_stamp = InputStamp();
     }
     ~InputManager() {}
 
-    void onKeyDown(SDL_Scancode scancode) { m_newStates[scancode] = true; }
-    void onKeyUp(SDL_Scancode scancode) { m_newStates[scancode] = false; }
+    void onKeyDown(SDL_Scancode scancode) { m_held[scancode >> 6] |= bit(scancode); }
+    void onKeyUp(SDL_Scancode scancode) { m_held[scancode >> 6] &= ~bit(scancode); }
+
+    // Notes when an event was sampled and polled; the earliest one since
+    // the last update() is kept.
+    void stampEvent(uint64 sampled, uint64 polled)
+    {
+        if (m_pending.sampled == 0 || sampled < m_pending.sampled)
+        {
+            m_pending.sampled = sampled;
+            m_pending.polled = polled;
+        }
+    }
+
+    // The input this frame reflects; sampled is 0 if nothing happened.
+    const InputStamp& stamp() const { return m_stamp; }
 
-    bool getKey(SDL_Scancode scancode) const { return m_newStates[scancode]; }
-    bool getKeyDown(SDL_Scancode scancode) const { return m_newStates[scancode] && !m_oldStates[scancode]; }
-    bool getKeyUp(SDL_Scancode scancode) const { return !m_newStates[scancode] && m_oldStates[scancode]; }
+    bool getKey(SDL_Scancode scancode) const { return (m_held[scancode >> 6] & bit(scancode)) != 0; }
+    bool getKeyDown(SDL_Scancode scancode) const { return (m_pressed[scancode >> 6] & bit(scancode)) != 0; }
+    bool getKeyUp(SDL_Scancode scancode) const { return (m_released[scancode >> 6] & bit(scancode)) != 0; }
 
-    void update() { std::copy(std::begin(m_newStates), std::end(m_newStates), std::begin(m_oldStates)); }
+    void update()
+    {
+        for (int i = 0; i < cWords; ++i)
+        {
+            const uint64 changed = m_held[i] ^ m_previous[i];
+            m_pressed[i] = changed & m_held[i];
+            m_released[i] = changed & m_previous[i];
+            m_previous[i] = m_held[i];
+        }
+        m_stamp = m_pending;
+        m_pending = InputStamp();
+    }
+
+    // Forgets the edges but keeps the held keys and stamp, for the second
+    // and later steps run on one frame's input.
+    void clearEdges()
+    {
+        std::fill(std::begin(m_pressed), std::end(m_pressed), 0);
+        std::fill(std::begin(m_released), std::end(m_released), 0);
+    }
 
 private:
-    bool m_oldStates[SDL_NUM_SCANCODES];
-    bool m_newStates[SDL_NUM_SCANCODES];
-};
\ No newline at end of file
+    static uint64 bit(SDL_Scancode scancode) { return (uint64)1 << (scancode & 63); }
+
+    uint64 m_held[cWords];
+    uint64 m_previous[cWords]; // held at the last update()
+    uint64 m_pressed[cWords];
+    uint64 m_released[cWords];
+    InputStamp m_pending;
+    InputStamp m_stamp;
+};
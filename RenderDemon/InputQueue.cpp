@@ -0,0 +1,114 @@
+#include "InputQueue.h"
+
+InputQueue::InputQueue()
+    : m_head(0),
+    m_tail(0),
+    m_dropped(0)
+{
+}
+
+bool InputQueue::push(const InputEvent& event)
+{
+    const uint32 tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) >= cCapacity)
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_events[tail & (cCapacity - 1)] = event;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool InputQueue::pop(InputEvent& event)
+{
+    const uint32 head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    event = m_events[head & (cCapacity - 1)];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+InputSampler::InputSampler(InputQueue& queue)
+    : m_queue(queue),
+    m_window(nullptr),
+    m_ready(false),
+    m_stop(false)
+{
+}
+
+InputSampler::~InputSampler()
+{
+    stop();
+}
+
+SDL_Window* InputSampler::start(const char* title, int width, int height)
+{
+    m_ready = false;
+    m_stop = false;
+    m_thread = std::thread(&InputSampler::samplerMain, this, title, width, height);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_created.wait(lock, [this] { return m_ready; });
+    return m_window;
+}
+
+void InputSampler::stop()
+{
+    if (m_thread.joinable())
+    {
+        m_stop.store(true, std::memory_order_release);
+        m_thread.join();
+    }
+}
+
+void InputSampler::samplerMain(const char* title, int width, int height)
+{
+    SDL_Window* window = SDL_CreateWindow(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+        width, height, SDL_WINDOW_SHOWN);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_window = window;
+        m_ready = true;
+    }
+    m_created.notify_one();
+    if (!window)
+    {
+        return;
+    }
+
+    // SDL_WaitEventTimeout sleeps 10ms between polls in this SDL, so the
+    // queue is pumped and drained by hand with a 1ms sleep instead.
+    SDL_Event event;
+    while (!m_stop.load(std::memory_order_acquire))
+    {
+        SDL_PumpEvents();
+        while (SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) > 0)
+        {
+            sample(event);
+        }
+        SDL_Delay(1);
+    }
+
+    SDL_DestroyWindow(window);
+}
+
+void InputSampler::sample(const SDL_Event& event)
+{
+    InputEvent input = { SDL_GetPerformanceCounter(), SDL_SCANCODE_UNKNOWN, InputEventType::Quit };
+    if (event.type == SDL_QUIT)
+    {
+        m_queue.push(input);
+    }
+    else if ((event.type == SDL_KEYDOWN && !event.key.repeat) || event.type == SDL_KEYUP)
+    {
+        input.scancode = event.key.keysym.scancode;
+        input.type = event.type == SDL_KEYDOWN ? InputEventType::KeyDown : InputEventType::KeyUp;
+        m_queue.push(input);
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Types.h"
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+enum class InputEventType : uint8
+{
+    KeyDown,
+    KeyUp,
+    Quit,
+};
+
+struct InputEvent
+{
+    uint64 time; // SDL_GetPerformanceCounter() when the event was sampled
+    SDL_Scancode scancode;
+    InputEventType type;
+};
+
+// Single-producer, single-consumer ring of input events. The sampling
+// thread pushes and the frame loop pops; neither ever waits on the other.
+// A full ring drops new events rather than block sampling.
+class InputQueue
+{
+public:
+    static const uint32 cCapacity = 1024; // power of two
+
+    InputQueue();
+
+    bool push(const InputEvent& event);
+    bool pop(InputEvent& event);
+
+    uint32 dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    InputQueue(const InputQueue&);
+    InputQueue& operator=(const InputQueue&);
+
+    // Free-running counts; the consumer owns m_head, the producer m_tail.
+    std::atomic<uint32> m_head;
+    std::atomic<uint32> m_tail;
+    std::atomic<uint32> m_dropped;
+    InputEvent m_events[cCapacity];
+};
+
+// Pumps SDL events into a queue as they arrive, stamping each with the time
+// it was seen. SDL only delivers window events to the thread that created
+// the window, so the sampling thread creates it and hands it back; the frame
+// loop keeps the main thread and its renderer, and a slow frame never holds
+// up sampling.
+class InputSampler
+{
+public:
+    explicit InputSampler(InputQueue& queue);
+    ~InputSampler();
+
+    // Starts the sampling thread and returns the window it created, or null
+    // if it could not create one.
+    SDL_Window* start(const char* title, int width, int height);
+
+    // Stops sampling and destroys the window. Anything rendering to it must
+    // be gone first.
+    void stop();
+
+private:
+    InputSampler(const InputSampler&);
+    InputSampler& operator=(const InputSampler&);
+
+    void samplerMain(const char* title, int width, int height);
+    void sample(const SDL_Event& event);
+
+    InputQueue& m_queue;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_created;
+    SDL_Window* m_window;
+    bool m_ready;
+    std::atomic<bool> m_stop;
+};
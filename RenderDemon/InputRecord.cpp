@@ -0,0 +1,185 @@
+#include "InputRecord.h"
+
+#include <algorithm>
+
+namespace
+{
+    const uint32 cMagic = 0x4E494452; // "RDIN"
+    const uint32 cVersion = 1;
+    const uint32 cEndMarker = 0xFFFFFFFF;
+}
+
+InputRecorder::InputRecorder()
+    : m_file(nullptr),
+    m_frames(0)
+{
+    m_held.reserve(SDL_NUM_SCANCODES);
+    m_previous.reserve(SDL_NUM_SCANCODES);
+}
+
+InputRecorder::~InputRecorder()
+{
+    close();
+}
+
+bool InputRecorder::open(const char* path)
+{
+    close();
+
+    m_file = fopen(path, "wb");
+    if (!m_file)
+    {
+        SDL_Log("input: could not open %s for writing", path);
+        return false;
+    }
+
+    const uint32 header[2] = { cMagic, cVersion };
+    fwrite(header, sizeof(header), 1, m_file);
+
+    m_frames = 0;
+    m_previous.clear();
+    return true;
+}
+
+void InputRecorder::close()
+{
+    if (!m_file)
+    {
+        return;
+    }
+
+    // The end record carries the total frame count so playback knows how long to run.
+    const uint32 end[2] = { m_frames, cEndMarker };
+    fwrite(end, sizeof(end), 1, m_file);
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+void InputRecorder::recordFrame(uint32 frame, const InputManager& input)
+{
+    if (!m_file)
+    {
+        return;
+    }
+
+    m_held.clear();
+    for (int i = 0; i < SDL_NUM_SCANCODES; ++i)
+    {
+        if (input.getKey((SDL_Scancode)i))
+        {
+            m_held.push_back((uint16)i);
+        }
+    }
+
+    if (frame == 0 || m_held != m_previous)
+    {
+        const uint32 record[2] = { frame, (uint32)m_held.size() };
+        fwrite(record, sizeof(record), 1, m_file);
+        if (!m_held.empty())
+        {
+            fwrite(m_held.data(), sizeof(uint16), m_held.size(), m_file);
+        }
+        m_previous.swap(m_held);
+    }
+
+    m_frames = frame + 1;
+}
+
+InputPlayback::InputPlayback()
+    : m_frames(0),
+    m_next(0)
+{
+    std::fill(std::begin(m_held), std::end(m_held), false);
+}
+
+bool InputPlayback::load(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        SDL_Log("input: could not open %s", path);
+        return false;
+    }
+
+    uint32 header[2];
+    if (fread(header, sizeof(header), 1, file) != 1 || header[0] != cMagic || header[1] != cVersion)
+    {
+        SDL_Log("input: %s is not a version %u input recording", path, cVersion);
+        fclose(file);
+        return false;
+    }
+
+    m_records.clear();
+    m_keys.clear();
+    m_frames = 0;
+    m_next = 0;
+
+    bool complete = false;
+    uint32 record[2];
+    while (fread(record, sizeof(record), 1, file) == 1)
+    {
+        if (record[1] == cEndMarker)
+        {
+            m_frames = record[0];
+            complete = true;
+            break;
+        }
+
+        // A record never holds more keys than there are scancodes.
+        if (record[1] > SDL_NUM_SCANCODES)
+        {
+            SDL_Log("input: %s has a record of %u keys", path, record[1]);
+            fclose(file);
+            return false;
+        }
+
+        Record r = { record[0], (uint32)m_keys.size(), record[1] };
+        m_keys.resize(m_keys.size() + r.count);
+        if (r.count > 0 && fread(&m_keys[r.first], sizeof(uint16), r.count, file) != r.count)
+        {
+            break;
+        }
+        m_records.push_back(r);
+    }
+    fclose(file);
+
+    if (!complete)
+    {
+        SDL_Log("input: %s is truncated", path);
+        return false;
+    }
+
+    return true;
+}
+
+void InputPlayback::apply(uint32 frame, InputManager& input)
+{
+    while (m_next < m_records.size() && m_records[m_next].frame <= frame)
+    {
+        const Record& r = m_records[m_next++];
+
+        // Recorded input has no sampling time; it counts from being applied.
+        const uint64 now = SDL_GetPerformanceCounter();
+        input.stampEvent(now, now);
+
+        bool held[SDL_NUM_SCANCODES] = {};
+        for (uint32 i = 0; i < r.count; ++i)
+        {
+            uint16 key = m_keys[r.first + i];
+            if (key < SDL_NUM_SCANCODES)
+            {
+                held[key] = true;
+            }
+        }
+
+        for (int i = 0; i < SDL_NUM_SCANCODES; ++i)
+        {
+            if (held[i] != m_held[i])
+            {
+                if (held[i]) { input.onKeyDown((SDL_Scancode)i); }
+                else { input.onKeyUp((SDL_Scancode)i); }
+                m_held[i] = held[i];
+            }
+        }
+    }
+}
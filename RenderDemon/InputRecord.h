@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Types.h"
+#include "Input.h"
+
+#include <cstdio>
+#include <vector>
+
+// Records the key state seen by each frame. A record is only written when
+// the set of held keys changes; each record carries the frame index it
+// takes effect on, so playback is exact regardless of frame timing.
+class InputRecorder
+{
+public:
+    InputRecorder();
+    ~InputRecorder();
+
+    bool open(const char* path);
+    void close();
+
+    void recordFrame(uint32 frame, const InputManager& input);
+
+private:
+    InputRecorder(const InputRecorder&);
+    InputRecorder& operator=(const InputRecorder&);
+
+    FILE* m_file;
+    uint32 m_frames;
+    std::vector<uint16> m_held;
+    std::vector<uint16> m_previous;
+};
+
+class InputPlayback
+{
+public:
+    InputPlayback();
+
+    bool load(const char* path);
+
+    uint32 frames() const { return m_frames; }
+
+    // Drives input to the state recorded for the given frame.
+    void apply(uint32 frame, InputManager& input);
+
+private:
+    struct Record
+    {
+        uint32 frame;
+        uint32 first;
+        uint32 count;
+    };
+
+    uint32 m_frames;
+    uint32 m_next;
+    std::vector<Record> m_records;
+    std::vector<uint16> m_keys;
+    bool m_held[SDL_NUM_SCANCODES];
+};
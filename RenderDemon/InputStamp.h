@@ -0,0 +1,13 @@
+#pragma once
+
+#include "Types.h"
+
+// When an input change reached each stage on its way to the screen, in
+// SDL_GetPerformanceCounter() ticks. sampled is 0 when there was none.
+struct InputStamp
+{
+    uint64 sampled; // the first event was seen by the sampler
+    uint64 polled; // the frame loop took it from the queue
+    uint64 updated; // the simulation step applying it finished
+    uint64 rendered; // the frame showing it was drawn, post included
+};
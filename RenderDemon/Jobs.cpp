@@ -0,0 +1,315 @@
+#include "Jobs.h"
+#include "Memory.h"
+
+#include <cstring>
+
+namespace
+{
+    // Idle workers keep looking for this many rounds before they sleep.
+    const int cSpinRounds = 64;
+
+    // The system and worker index of the calling thread; -1 outside one.
+    THREAD_LOCAL const JobSystem* t_system = nullptr;
+    THREAD_LOCAL int t_worker = -1;
+}
+
+JobSystem::Queue::Queue()
+    : m_top(0),
+    m_bottom(0)
+{
+}
+
+void JobSystem::Queue::write(Slot& slot, const Job& job)
+{
+    uintptr_t words[cSlotWords] = {};
+    memcpy(words, &job, sizeof(Job));
+    for (int i = 0; i < cSlotWords; ++i)
+    {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+}
+
+void JobSystem::Queue::read(const Slot& slot, Job& job)
+{
+    uintptr_t words[cSlotWords];
+    for (int i = 0; i < cSlotWords; ++i)
+    {
+        words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    memcpy(&job, words, sizeof(Job));
+}
+
+bool JobSystem::Queue::push(const Job& job)
+{
+    const int64 b = m_bottom.load(std::memory_order_relaxed);
+    const int64 t = m_top.load(std::memory_order_acquire);
+    if (b - t >= cMaxJobsPerThread)
+    {
+        return false;
+    }
+
+    // Releasing bottom publishes the job to thieves that acquire it.
+    write(m_slots[b & (cMaxJobsPerThread - 1)], job);
+    m_bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+bool JobSystem::Queue::pop(Job& job)
+{
+    // Claim the bottom slot first, then check a thief has not taken it.
+    const int64 b = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64 t = m_top.load(std::memory_order_relaxed);
+
+    if (t > b)
+    {
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    read(m_slots[b & (cMaxJobsPerThread - 1)], job);
+    if (t == b)
+    {
+        // Last job: race the thieves for it through top.
+        const bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+bool JobSystem::Queue::steal(Job& job)
+{
+    int64 t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64 b = m_bottom.load(std::memory_order_acquire);
+    if (t >= b)
+    {
+        return false;
+    }
+
+    // Copied before claiming: once top moves the owner may reuse the slot.
+    // If it already has, the claim fails and the copy is dropped.
+    read(m_slots[t & (cMaxJobsPerThread - 1)], job);
+    return m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+bool JobSystem::Queue::empty() const
+{
+    return m_top.load(std::memory_order_acquire) >= m_bottom.load(std::memory_order_acquire);
+}
+
+JobSystem::JobSystem(int threads)
+    : m_sleeping(0),
+    m_signals(0),
+    m_quit(false)
+{
+    Memory::Scope memoryScope(Memory::Tag::General);
+
+    if (threads <= 0)
+    {
+        threads = (int)std::thread::hardware_concurrency();
+    }
+    if (threads <= 0)
+    {
+        threads = 1;
+    }
+
+    for (int i = 0; i < threads; ++i)
+    {
+        m_queues.push_back(new Queue);
+    }
+
+    t_system = this;
+    t_worker = 0;
+    for (int i = 1; i < threads; ++i)
+    {
+        m_workers.push_back(std::thread(&JobSystem::workerMain, this, i));
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+    for (Queue* queue : m_queues)
+    {
+        delete queue;
+    }
+
+    if (t_system == this)
+    {
+        t_system = nullptr;
+        t_worker = -1;
+    }
+}
+
+void JobSystem::run(JobFunction fn, void* context, JobCounter* counter, const JobCounter* dependency)
+{
+    Job job = { fn, nullptr, context, 0, 0, counter, dependency };
+    if (counter)
+    {
+        counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    queue(job);
+}
+
+void JobSystem::parallelFor(int count, int grain, RangeFunction fn, void* context)
+{
+    grain = grain < 1 ? 1 : grain;
+    if (count <= grain || m_queues.size() == 1)
+    {
+        if (count > 0)
+        {
+            fn(context, 0, count);
+        }
+        return;
+    }
+
+    JobCounter counter;
+    for (int begin = 0; begin < count; begin += grain)
+    {
+        Job job = { nullptr, fn, context, begin, begin + grain < count ? begin + grain : count, &counter, nullptr };
+        counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+        queue(job);
+    }
+    wait(counter);
+}
+
+void JobSystem::wait(const JobCounter& counter)
+{
+    const int self = t_system == this ? t_worker : -1;
+    Job job;
+    while (!counter.done())
+    {
+        if (findJob(self, job))
+        {
+            execute(job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::queue(const Job& job)
+{
+    const int self = t_system == this ? t_worker : -1;
+    if (self < 0 || !m_queues[self]->push(job))
+    {
+        execute(job);
+        return;
+    }
+
+    // Pairs with the sleeper's increment before it checks the queues: either
+    // it sees this job or this sees it asleep.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed) > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_signals;
+        }
+        m_wake.notify_one();
+    }
+}
+
+void JobSystem::execute(const Job& job)
+{
+    if (job.dependency)
+    {
+        wait(*job.dependency);
+    }
+
+    if (job.range)
+    {
+        job.range(job.context, job.begin, job.end);
+    }
+    else
+    {
+        job.function(job.context);
+    }
+
+    if (job.counter)
+    {
+        job.counter->m_pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+bool JobSystem::findJob(int self, Job& job)
+{
+    if (self >= 0 && m_queues[self]->pop(job))
+    {
+        return true;
+    }
+
+    const int count = (int)m_queues.size();
+    for (int i = 1; i <= count; ++i)
+    {
+        const int victim = (self + i + count) % count;
+        if (victim != self && m_queues[victim]->steal(job))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobSystem::anyQueued() const
+{
+    for (const Queue* queue : m_queues)
+    {
+        if (!queue->empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::workerMain(int index)
+{
+    t_system = this;
+    t_worker = index;
+
+    Job job;
+    int idle = 0;
+    for (;;)
+    {
+        if (findJob(index, job))
+        {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < cSpinRounds)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        idle = 0;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_quit)
+        {
+            return;
+        }
+        m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+        const uint64 seen = m_signals;
+        if (!anyQueued())
+        {
+            m_wake.wait(lock, [this, seen] { return m_signals != seen || m_quit; });
+        }
+        m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Types.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// Counts unfinished jobs. Every job given a counter adds one to it when it
+// is queued and takes one off when it has run; waiting on a counter is how
+// callers and dependent jobs wait for a batch of work.
+class JobCounter
+{
+public:
+    JobCounter() : m_pending(0) {}
+
+    bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    JobCounter(const JobCounter&);
+    JobCounter& operator=(const JobCounter&);
+
+    friend class JobSystem;
+    std::atomic<int> m_pending;
+};
+
+// The one scheduler shared by every subsystem: a fixed set of threads, each
+// with its own work-stealing deque (Chase-Lev). A thread pushes and pops
+// its own jobs at the bottom, newest first; idle threads steal the oldest
+// from the top of someone else's. The thread that creates the system takes
+// part as worker 0. Waiting never blocks a worker outright: it runs queued
+// jobs until the counter drops to zero.
+//
+// Jobs and deques live in fixed arrays allocated up front, so queuing and
+// running work never touches the heap. Threads outside the system (and a
+// full deque) run their jobs inline instead.
+class JobSystem
+{
+public:
+    static const int cMaxJobsPerThread = 1024; // queued at once, per thread
+
+    typedef void (*JobFunction)(void* context);
+    typedef void (*RangeFunction)(void* context, int begin, int end);
+
+    // threads counts the creating thread; 0 uses one per hardware thread.
+    explicit JobSystem(int threads = 0);
+    ~JobSystem();
+
+    int threads() const { return (int)m_queues.size(); }
+
+    // Queues fn(context). counter, if given, is done once it has run. The
+    // job does not start before dependency, if given, is done.
+    void run(JobFunction fn, void* context, JobCounter* counter, const JobCounter* dependency = nullptr);
+
+    // Runs queued jobs until counter is done.
+    void wait(const JobCounter& counter);
+
+    // Calls fn(context, begin, end) over [0, count) in ranges of at most
+    // grain and returns once all have run. Ranges may run in any order and
+    // on any thread, the caller's included.
+    void parallelFor(int count, int grain, RangeFunction fn, void* context);
+
+private:
+    JobSystem(const JobSystem&);
+    JobSystem& operator=(const JobSystem&);
+
+    struct Job
+    {
+        JobFunction function;
+        RangeFunction range;
+        void* context;
+        int begin;
+        int end;
+        JobCounter* counter;
+        const JobCounter* dependency;
+    };
+
+    // Chase-Lev deque. Jobs are stored by value at their position, so a
+    // slot is only rewritten once top has moved past it. Only the owner
+    // pushes and pops; anyone may steal.
+    class Queue
+    {
+    public:
+        Queue();
+
+        bool push(const Job& job);
+        bool pop(Job& job);
+        bool steal(Job& job);
+        bool empty() const;
+
+    private:
+        // A thief may still be reading a slot the owner is rewriting (its
+        // claim then fails), so slots are copied a word at a time through
+        // relaxed atomics rather than as plain structs.
+        static const int cSlotWords = (sizeof(Job) + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+        struct Slot
+        {
+            std::atomic<uintptr_t> words[cSlotWords];
+        };
+
+        static void write(Slot& slot, const Job& job);
+        static void read(const Slot& slot, Job& job);
+
+        std::atomic<int64> m_top;
+        std::atomic<int64> m_bottom;
+        Slot m_slots[cMaxJobsPerThread];
+    };
+
+    void queue(const Job& job);
+    void execute(const Job& job);
+    // Pops from the calling thread's deque, else steals from the others.
+    bool findJob(int self, Job& job);
+    bool anyQueued() const;
+    void workerMain(int index);
+
+    std::vector<Queue*> m_queues;
+    std::vector<std::thread> m_workers;
+
+    // Idle workers sleep here; queue() only takes the lock if one is asleep.
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::atomic<int> m_sleeping;
+    uint64 m_signals; // guarded by m_mutex
+    bool m_quit; // guarded by m_mutex
+};
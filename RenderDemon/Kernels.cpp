@@ -0,0 +1,253 @@
+#include "Kernels.h"
+
+#include <SDL2/SDL.h>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define KERNELS_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+    void fillSpan(uint32* dst, int count, uint32 color)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i] = color;
+        }
+    }
+
+    void blendSpan(uint32* dst, int count, uint32 color, uint32 alpha)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i] = Kernels::Internal::blendPixel(color, dst[i], alpha);
+        }
+    }
+
+    void expandPalette(uint32* dst, const uint8* src, int count, const uint32* palette)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i] = palette[src[i]];
+        }
+    }
+
+    void clear(void* pixels, int pitch, int width, int height, uint32 color)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            fillSpan((uint32*)((uint8*)pixels + y * pitch), width, color);
+        }
+    }
+
+    void convert(uint32* dst, const uint32* src, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i] = Kernels::Internal::convertPixel(src[i]);
+        }
+    }
+
+    void convolve(uint32* dst, const uint32* const* taps, const uint16* weights, int tapCount, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i] = Kernels::Internal::convolvePixel(taps, weights, tapCount, i);
+        }
+    }
+
+    void modulate(uint32* dst, const uint16* weights, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i] = Kernels::Internal::modulatePixel(dst[i], weights[i]);
+        }
+    }
+
+    void addSpan(uint32* dst, const uint32* src, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i] = Kernels::Internal::addPixel(dst[i], src[i]);
+        }
+    }
+
+    void subtractSpan(uint32* dst, const uint32* src, int count, uint32 value)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i] = Kernels::Internal::subtractPixel(src[i], value);
+        }
+    }
+
+    const Kernels::Table cScalarTable = {
+        Kernels::Level::Scalar,
+        fillSpan,
+        blendSpan,
+        expandPalette,
+        clear,
+        convert,
+        Kernels::Internal::upscaleRow,
+        Kernels::Internal::applyLut,
+        Kernels::Internal::applyCube,
+        convolve,
+        modulate,
+        addSpan,
+        subtractSpan,
+    };
+
+#if KERNELS_X86
+    void cpuid(int leaf, int subleaf, uint32 regs[4])
+    {
+#if defined(_MSC_VER)
+        __cpuidex((int*)regs, leaf, subleaf);
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    bool cpuHasAVX2()
+    {
+        uint32 regs[4];
+        cpuid(0, 0, regs);
+        if (regs[0] < 7)
+        {
+            return false;
+        }
+
+        // AVX2 also needs the OS to save YMM state on context switch.
+        cpuid(1, 0, regs);
+        const uint32 cOSXSAVE = 1u << 27;
+        const uint32 cAVX = 1u << 28;
+        if ((regs[2] & (cOSXSAVE | cAVX)) != (cOSXSAVE | cAVX))
+        {
+            return false;
+        }
+
+#if defined(_MSC_VER)
+        uint64 xcr0 = _xgetbv(0);
+#else
+        uint32 lo, hi;
+        __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        uint64 xcr0 = ((uint64)hi << 32) | lo;
+#endif
+        if ((xcr0 & 0x6) != 0x6)
+        {
+            return false;
+        }
+
+        cpuid(7, 0, regs);
+        return (regs[1] & (1u << 5)) != 0;
+    }
+#endif
+
+    Kernels::Level g_override = Kernels::Level::Count;
+}
+
+namespace Kernels
+{
+    namespace Internal
+    {
+        const Table* scalarTable()
+        {
+            return &cScalarTable;
+        }
+    }
+
+    const char* levelName(Level level)
+    {
+        switch (level)
+        {
+        case Level::Scalar: return "scalar";
+        case Level::SSE2: return "sse2";
+        case Level::AVX2: return "avx2";
+        case Level::NEON: return "neon";
+        default: return "unknown";
+        }
+    }
+
+    bool parseLevel(const char* name, Level* level)
+    {
+        for (int i = 0; i < (int)Level::Count; ++i)
+        {
+            if (strcmp(name, levelName((Level)i)) == 0)
+            {
+                *level = (Level)i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool supported(Level level)
+    {
+        switch (level)
+        {
+        case Level::Scalar:
+            return true;
+        case Level::SSE2:
+#if KERNELS_X86
+            return Internal::sse2Table() && SDL_HasSSE2();
+#else
+            return false;
+#endif
+        case Level::AVX2:
+#if KERNELS_X86
+            return Internal::avx2Table() && cpuHasAVX2();
+#else
+            return false;
+#endif
+        case Level::NEON:
+            return Internal::neonTable() != nullptr;
+        default:
+            return false;
+        }
+    }
+
+    Level detect()
+    {
+        static const Level cPreference[] = { Level::AVX2, Level::NEON, Level::SSE2 };
+        for (Level level : cPreference)
+        {
+            if (supported(level))
+            {
+                return level;
+            }
+        }
+        return Level::Scalar;
+    }
+
+    void setOverride(Level level)
+    {
+        g_override = level;
+    }
+
+    const Table& table(Level level)
+    {
+        // Walk down to the nearest supported level; scalar always is.
+        while (level != Level::Scalar && !supported(level))
+        {
+            level = (level == Level::NEON) ? Level::Scalar : (Level)((int)level - 1);
+        }
+
+        switch (level)
+        {
+        case Level::SSE2: return *Internal::sse2Table();
+        case Level::AVX2: return *Internal::avx2Table();
+        case Level::NEON: return *Internal::neonTable();
+        default: return cScalarTable;
+        }
+    }
+
+    const Table& active()
+    {
+        return table(g_override != Level::Count ? g_override : detect());
+    }
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "Types.h"
+
+// Per-ISA implementations of the rasterizer's inner loops. Every level
+// produces bit-identical output; the table is picked once when a Canvas is
+// constructed, from the best level the CPU supports unless overridden.
+namespace Kernels
+{
+    enum class Level
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+        NEON,
+        Count,
+    };
+
+    struct Table
+    {
+        Level level;
+
+        // dst[0..count) = color
+        void (*fillSpan)(uint32* dst, int count, uint32 color);
+        // Blends color over dst[0..count) with a constant alpha, per byte:
+        // (color * alpha + dst * (255 - alpha)) / 255, rounded.
+        void (*blendSpan)(uint32* dst, int count, uint32 color, uint32 alpha);
+        // dst[i] = palette[src[i]]
+        void (*expandPalette)(uint32* dst, const uint8* src, int count, const uint32* palette);
+        // Fills a whole 32-bit surface.
+        void (*clear)(void* pixels, int pitch, int width, int height, uint32 color);
+        // Converts surface pixels (R in the low byte) to ARGB8888 with opaque alpha.
+        void (*convert)(uint32* dst, const uint32* src, int count);
+        // Nearest-neighbour horizontal upscale: dst[i * scale + j] = src[i].
+        void (*upscaleRow)(uint32* dst, const uint32* src, int count, int scale);
+        // Per-byte table lookup: tables holds three 256-entry tables, indexed
+        // by bytes 0, 1 and 2 of each pixel, whose results are ORed together
+        // with opaque alpha.
+        void (*applyLut)(uint32* dst, const uint32* src, int count, const uint32* tables);
+        // 3D table lookup: cube holds 64^3 entries indexed by the top six bits
+        // of bytes 0, 1 and 2 of each pixel, byte 0 varying fastest.
+        void (*applyCube)(uint32* dst, const uint32* src, int count, const uint32* cube);
+        // Per byte: dst[i] = (sum of weights[t] * taps[t][i] + 128) >> 8. The
+        // weights must sum to at most 256.
+        void (*convolve)(uint32* dst, const uint32* const* taps, const uint16* weights, int tapCount, int count);
+        // Per byte: dst[i] = (dst[i] * weights[i] + 128) >> 8, weights at most 256.
+        void (*modulate)(uint32* dst, const uint16* weights, int count);
+        // Per byte, saturating: dst[i] = min(dst[i] + src[i], 255).
+        void (*addSpan)(uint32* dst, const uint32* src, int count);
+        // Per byte, saturating: dst[i] = max(src[i] - value, 0).
+        void (*subtractSpan)(uint32* dst, const uint32* src, int count, uint32 value);
+    };
+
+    const char* levelName(Level level);
+    bool parseLevel(const char* name, Level* level);
+
+    // Best level supported by this CPU and build.
+    Level detect();
+    bool supported(Level level);
+
+    // Forces a level for testing; Level::Count clears the override. Unsupported
+    // levels fall back to the best supported level below them.
+    void setOverride(Level level);
+
+    // Table for the override if set, otherwise for detect().
+    const Table& active();
+    const Table& table(Level level);
+
+    namespace Internal
+    {
+        // Null when the level is not compiled in for this architecture.
+        const Table* scalarTable();
+        const Table* sse2Table();
+        const Table* avx2Table();
+        const Table* neonTable();
+
+        // Shared scalar helpers so every level handles its tail identically.
+        inline uint32 blendPixel(uint32 color, uint32 dst, uint32 alpha)
+        {
+            uint32 result = 0;
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                uint32 s = (color >> shift) & 0xFF;
+                uint32 d = (dst >> shift) & 0xFF;
+                uint32 t = s * alpha + d * (255 - alpha) + 128;
+                result |= (((t + (t >> 8)) >> 8) & 0xFF) << shift;
+            }
+            return result;
+        }
+
+        inline void upscaleRow(uint32* dst, const uint32* src, int count, int scale)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                for (int j = 0; j < scale; ++j)
+                {
+                    *dst++ = src[i];
+                }
+            }
+        }
+
+        inline uint32 lutPixel(uint32 p, const uint32* tables)
+        {
+            return tables[p & 0xFF] | tables[256 + ((p >> 8) & 0xFF)] | tables[512 + ((p >> 16) & 0xFF)] | 0xFF000000;
+        }
+
+        inline void applyLut(uint32* dst, const uint32* src, int count, const uint32* tables)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                dst[i] = lutPixel(src[i], tables);
+            }
+        }
+
+        inline uint32 cubeIndex(uint32 p)
+        {
+            return ((p >> 2) & 0x3F) | ((p >> 4) & 0xFC0) | ((p >> 6) & 0x3F000);
+        }
+
+        inline void applyCube(uint32* dst, const uint32* src, int count, const uint32* cube)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                dst[i] = cube[cubeIndex(src[i])];
+            }
+        }
+
+        inline uint32 convolvePixel(const uint32* const* taps, const uint16* weights, int tapCount, int i)
+        {
+            uint32 result = 0;
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                uint32 sum = 128;
+                for (int t = 0; t < tapCount; ++t)
+                {
+                    sum += weights[t] * ((taps[t][i] >> shift) & 0xFF);
+                }
+                result |= (sum >> 8) << shift;
+            }
+            return result;
+        }
+
+        inline uint32 modulatePixel(uint32 p, uint32 weight)
+        {
+            uint32 result = 0;
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                result |= ((((p >> shift) & 0xFF) * weight + 128) >> 8) << shift;
+            }
+            return result;
+        }
+
+        inline uint32 addPixel(uint32 a, uint32 b)
+        {
+            uint32 result = 0;
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                uint32 sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF);
+                result |= (sum > 255 ? 255 : sum) << shift;
+            }
+            return result;
+        }
+
+        inline uint32 subtractPixel(uint32 a, uint32 b)
+        {
+            uint32 result = 0;
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                uint32 x = (a >> shift) & 0xFF, y = (b >> shift) & 0xFF;
+                result |= (x > y ? x - y : 0) << shift;
+            }
+            return result;
+        }
+
+        inline uint32 convertPixel(uint32 p)
+        {
+            return (p & 0x0000FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16) | 0xFF000000;
+        }
+    }
+}
@@ -0,0 +1,299 @@
+#include "Kernels.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+// MSVC accepts AVX2 intrinsics in any function; GCC and Clang need the
+// target enabled per function so the rest of the build stays baseline.
+#if defined(_MSC_VER)
+#define KERNEL_AVX2
+#else
+#define KERNEL_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace
+{
+    using Kernels::Internal::blendPixel;
+    using Kernels::Internal::convertPixel;
+    using Kernels::Internal::convolvePixel;
+    using Kernels::Internal::modulatePixel;
+    using Kernels::Internal::addPixel;
+    using Kernels::Internal::subtractPixel;
+
+    KERNEL_AVX2 void fillSpan(uint32* dst, int count, uint32 color)
+    {
+        __m256i c = _mm256_set1_epi32((int)color);
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            _mm256_storeu_si256((__m256i*)(dst + i), c);
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = color;
+        }
+    }
+
+    KERNEL_AVX2 void blendSpan(uint32* dst, int count, uint32 color, uint32 alpha)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i a = _mm256_set1_epi16((short)alpha);
+        const __m256i ia = _mm256_set1_epi16((short)(255 - alpha));
+        const __m256i bias = _mm256_set1_epi16(128);
+        const __m256i s = _mm256_mullo_epi16(_mm256_unpacklo_epi8(_mm256_set1_epi32((int)color), zero), a);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+
+            // unpack/pack operate within 128-bit lanes, so the pair round-trips in order.
+            __m256i lo = _mm256_add_epi16(_mm256_add_epi16(s, _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), ia)), bias);
+            __m256i hi = _mm256_add_epi16(_mm256_add_epi16(s, _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), ia)), bias);
+            lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+            hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(lo, hi));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = blendPixel(color, dst[i], alpha);
+        }
+    }
+
+    KERNEL_AVX2 void expandPalette(uint32* dst, const uint8* src, int count, const uint32* palette)
+    {
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_i32gather_epi32((const int*)palette, index, 4));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = palette[src[i]];
+        }
+    }
+
+    KERNEL_AVX2 void applyLut(uint32* dst, const uint32* src, int count, const uint32* tables)
+    {
+        const __m256i mask = _mm256_set1_epi32(0xFF);
+        const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i p = _mm256_loadu_si256((const __m256i*)(src + i));
+            __m256i c0 = _mm256_i32gather_epi32((const int*)tables, _mm256_and_si256(p, mask), 4);
+            __m256i c1 = _mm256_i32gather_epi32((const int*)(tables + 256), _mm256_and_si256(_mm256_srli_epi32(p, 8), mask), 4);
+            __m256i c2 = _mm256_i32gather_epi32((const int*)(tables + 512), _mm256_and_si256(_mm256_srli_epi32(p, 16), mask), 4);
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(_mm256_or_si256(c0, c1), _mm256_or_si256(c2, alpha)));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = Kernels::Internal::lutPixel(src[i], tables);
+        }
+    }
+
+    KERNEL_AVX2 void applyCube(uint32* dst, const uint32* src, int count, const uint32* cube)
+    {
+        const __m256i mask0 = _mm256_set1_epi32(0x3F);
+        const __m256i mask1 = _mm256_set1_epi32(0xFC0);
+        const __m256i mask2 = _mm256_set1_epi32(0x3F000);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i p = _mm256_loadu_si256((const __m256i*)(src + i));
+            __m256i index = _mm256_or_si256(
+                _mm256_and_si256(_mm256_srli_epi32(p, 2), mask0),
+                _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(p, 4), mask1), _mm256_and_si256(_mm256_srli_epi32(p, 6), mask2)));
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_i32gather_epi32((const int*)cube, index, 4));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = cube[Kernels::Internal::cubeIndex(src[i])];
+        }
+    }
+
+    KERNEL_AVX2 void clear(void* pixels, int pitch, int width, int height, uint32 color)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            fillSpan((uint32*)((uint8*)pixels + y * pitch), width, color);
+        }
+    }
+
+    KERNEL_AVX2 void convert(uint32* dst, const uint32* src, int count)
+    {
+        // Swap bytes 0 and 2 of every pixel, then force alpha.
+        const __m256i shuffle = _mm256_setr_epi8(
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i p = _mm256_loadu_si256((const __m256i*)(src + i));
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(_mm256_shuffle_epi8(p, shuffle), alpha));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = convertPixel(src[i]);
+        }
+    }
+
+    KERNEL_AVX2 void upscaleRow(uint32* dst, const uint32* src, int count, int scale)
+    {
+        int i = 0;
+        if (scale == 2)
+        {
+            const __m256i lo = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+            const __m256i hi = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i p = _mm256_loadu_si256((const __m256i*)(src + i));
+                _mm256_storeu_si256((__m256i*)(dst + i * 2), _mm256_permutevar8x32_epi32(p, lo));
+                _mm256_storeu_si256((__m256i*)(dst + i * 2 + 8), _mm256_permutevar8x32_epi32(p, hi));
+            }
+        }
+        else if (scale == 3)
+        {
+            const __m256i a = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+            const __m256i b = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+            const __m256i c = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i p = _mm256_loadu_si256((const __m256i*)(src + i));
+                _mm256_storeu_si256((__m256i*)(dst + i * 3), _mm256_permutevar8x32_epi32(p, a));
+                _mm256_storeu_si256((__m256i*)(dst + i * 3 + 8), _mm256_permutevar8x32_epi32(p, b));
+                _mm256_storeu_si256((__m256i*)(dst + i * 3 + 16), _mm256_permutevar8x32_epi32(p, c));
+            }
+        }
+        else if (scale == 4)
+        {
+            const __m256i lo = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+            const __m256i hi = _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3);
+            for (; i + 4 <= count; i += 4)
+            {
+                __m256i p = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(src + i)));
+                _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_permutevar8x32_epi32(p, lo));
+                _mm256_storeu_si256((__m256i*)(dst + i * 4 + 8), _mm256_permutevar8x32_epi32(p, hi));
+            }
+        }
+        Kernels::Internal::upscaleRow(dst + i * scale, src + i, count - i, scale);
+    }
+
+    KERNEL_AVX2 void convolve(uint32* dst, const uint32* const* taps, const uint16* weights, int tapCount, int count)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i bias = _mm256_set1_epi16(128);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i lo = bias;
+            __m256i hi = bias;
+            for (int t = 0; t < tapCount; ++t)
+            {
+                __m256i w = _mm256_set1_epi16((short)weights[t]);
+                __m256i p = _mm256_loadu_si256((const __m256i*)(taps[t] + i));
+                lo = _mm256_add_epi16(lo, _mm256_mullo_epi16(_mm256_unpacklo_epi8(p, zero), w));
+                hi = _mm256_add_epi16(hi, _mm256_mullo_epi16(_mm256_unpackhi_epi8(p, zero), w));
+            }
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8)));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = convolvePixel(taps, weights, tapCount, i);
+        }
+    }
+
+    KERNEL_AVX2 void modulate(uint32* dst, const uint16* weights, int count)
+    {
+        const __m256i bias = _mm256_set1_epi32(128);
+        const __m256i mask = _mm256_set1_epi32(0xFF);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            // 32-bit lanes: one weight per pixel, each byte multiplied in turn.
+            __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(weights + i)));
+            __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+            __m256i out = _mm256_setzero_si256();
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                __m256i c = _mm256_and_si256(_mm256_srli_epi32(d, shift), mask);
+                c = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(c, w), bias), 8);
+                out = _mm256_or_si256(out, _mm256_sll_epi32(c, _mm_cvtsi32_si128(shift)));
+            }
+            _mm256_storeu_si256((__m256i*)(dst + i), out);
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = modulatePixel(dst[i], weights[i]);
+        }
+    }
+
+    KERNEL_AVX2 void addSpan(uint32* dst, const uint32* src, int count)
+    {
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+            __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_adds_epu8(d, s));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = addPixel(dst[i], src[i]);
+        }
+    }
+
+    KERNEL_AVX2 void subtractSpan(uint32* dst, const uint32* src, int count, uint32 value)
+    {
+        const __m256i v = _mm256_set1_epi32((int)value);
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_subs_epu8(s, v));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = subtractPixel(src[i], value);
+        }
+    }
+
+    const Kernels::Table cAVX2Table = {
+        Kernels::Level::AVX2,
+        fillSpan,
+        blendSpan,
+        expandPalette,
+        clear,
+        convert,
+        upscaleRow,
+        applyLut,
+        applyCube,
+        convolve,
+        modulate,
+        addSpan,
+        subtractSpan,
+    };
+}
+
+const Kernels::Table* Kernels::Internal::avx2Table()
+{
+    return &cAVX2Table;
+}
+
+#else
+
+const Kernels::Table* Kernels::Internal::avx2Table()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,208 @@
+#include "Kernels.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+
+#include <arm_neon.h>
+
+namespace
+{
+    using Kernels::Internal::blendPixel;
+    using Kernels::Internal::convertPixel;
+    using Kernels::Internal::convolvePixel;
+    using Kernels::Internal::modulatePixel;
+    using Kernels::Internal::addPixel;
+    using Kernels::Internal::subtractPixel;
+
+    void fillSpan(uint32* dst, int count, uint32 color)
+    {
+        uint32x4_t c = vdupq_n_u32(color);
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            vst1q_u32(dst + i, c);
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = color;
+        }
+    }
+
+    void blendSpan(uint32* dst, int count, uint32 color, uint32 alpha)
+    {
+        const uint8x8_t a = vdup_n_u8((uint8)alpha);
+        const uint8x8_t ia = vdup_n_u8((uint8)(255 - alpha));
+        const uint8x8_t c = vreinterpret_u8_u32(vdup_n_u32(color));
+        const uint16x8_t s = vaddq_u16(vmull_u8(c, a), vdupq_n_u16(128));
+
+        int i = 0;
+        for (; i + 2 <= count; i += 2)
+        {
+            uint8x8_t d = vreinterpret_u8_u32(vld1_u32(dst + i));
+            uint16x8_t t = vmlal_u8(s, d, ia);
+            // (t + (t >> 8)) >> 8, the same rounding as the scalar path.
+            uint8x8_t out = vshrn_n_u16(vsraq_n_u16(t, t, 8), 8);
+            vst1_u32(dst + i, vreinterpret_u32_u8(out));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = blendPixel(color, dst[i], alpha);
+        }
+    }
+
+    void expandPalette(uint32* dst, const uint8* src, int count, const uint32* palette)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i] = palette[src[i]];
+        }
+    }
+
+    void clear(void* pixels, int pitch, int width, int height, uint32 color)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            fillSpan((uint32*)((uint8*)pixels + y * pitch), width, color);
+        }
+    }
+
+    void convert(uint32* dst, const uint32* src, int count)
+    {
+        int i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            uint8x16x4_t p = vld4q_u8((const uint8*)(src + i));
+            uint8x16_t r = p.val[0];
+            p.val[0] = p.val[2];
+            p.val[2] = r;
+            p.val[3] = vdupq_n_u8(0xFF);
+            vst4q_u8((uint8*)(dst + i), p);
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = convertPixel(src[i]);
+        }
+    }
+
+    void upscaleRow(uint32* dst, const uint32* src, int count, int scale)
+    {
+        int i = 0;
+        if (scale == 2)
+        {
+            for (; i + 4 <= count; i += 4)
+            {
+                uint32x4_t p = vld1q_u32(src + i);
+                uint32x4x2_t z = vzipq_u32(p, p);
+                vst1q_u32(dst + i * 2, z.val[0]);
+                vst1q_u32(dst + i * 2 + 4, z.val[1]);
+            }
+        }
+        else if (scale == 4)
+        {
+            for (; i < count; ++i)
+            {
+                vst1q_u32(dst + i * 4, vdupq_n_u32(src[i]));
+            }
+        }
+        Kernels::Internal::upscaleRow(dst + i * scale, src + i, count - i, scale);
+    }
+
+    void convolve(uint32* dst, const uint32* const* taps, const uint16* weights, int tapCount, int count)
+    {
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            uint16x8_t lo = vdupq_n_u16(128);
+            uint16x8_t hi = vdupq_n_u16(128);
+            for (int t = 0; t < tapCount; ++t)
+            {
+                // Widen first: a weight of 256 does not fit vmlal_u8.
+                uint8x16_t p = vreinterpretq_u8_u32(vld1q_u32(taps[t] + i));
+                lo = vmlaq_n_u16(lo, vmovl_u8(vget_low_u8(p)), weights[t]);
+                hi = vmlaq_n_u16(hi, vmovl_u8(vget_high_u8(p)), weights[t]);
+            }
+            uint8x16_t out = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+            vst1q_u32(dst + i, vreinterpretq_u32_u8(out));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = convolvePixel(taps, weights, tapCount, i);
+        }
+    }
+
+    void modulate(uint32* dst, const uint16* weights, int count)
+    {
+        int i = 0;
+        for (; i + 2 <= count; i += 2)
+        {
+            uint16x4_t w0 = vdup_n_u16(weights[i]);
+            uint16x4_t w1 = vdup_n_u16(weights[i + 1]);
+            uint16x8_t d = vmovl_u8(vreinterpret_u8_u32(vld1_u32(dst + i)));
+            uint16x8_t t = vaddq_u16(vmulq_u16(d, vcombine_u16(w0, w1)), vdupq_n_u16(128));
+            vst1_u32(dst + i, vreinterpret_u32_u8(vshrn_n_u16(t, 8)));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = modulatePixel(dst[i], weights[i]);
+        }
+    }
+
+    void addSpan(uint32* dst, const uint32* src, int count)
+    {
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            uint8x16_t d = vreinterpretq_u8_u32(vld1q_u32(dst + i));
+            uint8x16_t s = vreinterpretq_u8_u32(vld1q_u32(src + i));
+            vst1q_u32(dst + i, vreinterpretq_u32_u8(vqaddq_u8(d, s)));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = addPixel(dst[i], src[i]);
+        }
+    }
+
+    void subtractSpan(uint32* dst, const uint32* src, int count, uint32 value)
+    {
+        const uint8x16_t v = vreinterpretq_u8_u32(vdupq_n_u32(value));
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            uint8x16_t s = vreinterpretq_u8_u32(vld1q_u32(src + i));
+            vst1q_u32(dst + i, vreinterpretq_u32_u8(vqsubq_u8(s, v)));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = subtractPixel(src[i], value);
+        }
+    }
+
+    const Kernels::Table cNEONTable = {
+        Kernels::Level::NEON,
+        fillSpan,
+        blendSpan,
+        expandPalette,
+        clear,
+        convert,
+        upscaleRow,
+        Kernels::Internal::applyLut, // table lookups only reach 64 bytes
+        Kernels::Internal::applyCube,
+        convolve,
+        modulate,
+        addSpan,
+        subtractSpan,
+    };
+}
+
+const Kernels::Table* Kernels::Internal::neonTable()
+{
+    return &cNEONTable;
+}
+
+#else
+
+const Kernels::Table* Kernels::Internal::neonTable()
+{
+    return nullptr;
+}
+
+#endif
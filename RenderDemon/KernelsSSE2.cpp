@@ -0,0 +1,235 @@
+#include "Kernels.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+
+#include <emmintrin.h>
+
+namespace
+{
+    using Kernels::Internal::blendPixel;
+    using Kernels::Internal::convertPixel;
+    using Kernels::Internal::convolvePixel;
+    using Kernels::Internal::modulatePixel;
+    using Kernels::Internal::addPixel;
+    using Kernels::Internal::subtractPixel;
+
+    void fillSpan(uint32* dst, int count, uint32 color)
+    {
+        __m128i c = _mm_set1_epi32((int)color);
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            _mm_storeu_si128((__m128i*)(dst + i), c);
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = color;
+        }
+    }
+
+    void blendSpan(uint32* dst, int count, uint32 color, uint32 alpha)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i a = _mm_set1_epi16((short)alpha);
+        const __m128i ia = _mm_set1_epi16((short)(255 - alpha));
+        const __m128i bias = _mm_set1_epi16(128);
+        const __m128i s = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero), a);
+
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+
+            __m128i lo = _mm_add_epi16(_mm_add_epi16(s, _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia)), bias);
+            __m128i hi = _mm_add_epi16(_mm_add_epi16(s, _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia)), bias);
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = blendPixel(color, dst[i], alpha);
+        }
+    }
+
+    void expandPalette(uint32* dst, const uint8* src, int count, const uint32* palette)
+    {
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i p = _mm_set_epi32((int)palette[src[i + 3]], (int)palette[src[i + 2]],
+                (int)palette[src[i + 1]], (int)palette[src[i + 0]]);
+            _mm_storeu_si128((__m128i*)(dst + i), p);
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = palette[src[i]];
+        }
+    }
+
+    void clear(void* pixels, int pitch, int width, int height, uint32 color)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            fillSpan((uint32*)((uint8*)pixels + y * pitch), width, color);
+        }
+    }
+
+    void convert(uint32* dst, const uint32* src, int count)
+    {
+        const __m128i keep = _mm_set1_epi32(0x0000FF00);
+        const __m128i low = _mm_set1_epi32(0x000000FF);
+        const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), low);
+            __m128i b = _mm_slli_epi32(_mm_and_si128(p, low), 16);
+            __m128i out = _mm_or_si128(_mm_or_si128(_mm_and_si128(p, keep), alpha), _mm_or_si128(r, b));
+            _mm_storeu_si128((__m128i*)(dst + i), out);
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = convertPixel(src[i]);
+        }
+    }
+
+    void upscaleRow(uint32* dst, const uint32* src, int count, int scale)
+    {
+        int i = 0;
+        if (scale == 2)
+        {
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+                _mm_storeu_si128((__m128i*)(dst + i * 2), _mm_unpacklo_epi32(p, p));
+                _mm_storeu_si128((__m128i*)(dst + i * 2 + 4), _mm_unpackhi_epi32(p, p));
+            }
+        }
+        else if (scale == 4)
+        {
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+                _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_shuffle_epi32(p, 0x00));
+                _mm_storeu_si128((__m128i*)(dst + i * 4 + 4), _mm_shuffle_epi32(p, 0x55));
+                _mm_storeu_si128((__m128i*)(dst + i * 4 + 8), _mm_shuffle_epi32(p, 0xAA));
+                _mm_storeu_si128((__m128i*)(dst + i * 4 + 12), _mm_shuffle_epi32(p, 0xFF));
+            }
+        }
+        Kernels::Internal::upscaleRow(dst + i * scale, src + i, count - i, scale);
+    }
+
+    void convolve(uint32* dst, const uint32* const* taps, const uint16* weights, int tapCount, int count)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16(128);
+
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i lo = bias;
+            __m128i hi = bias;
+            for (int t = 0; t < tapCount; ++t)
+            {
+                // Weights sum to 256 at most, so the 16-bit sums cannot overflow.
+                __m128i w = _mm_set1_epi16((short)weights[t]);
+                __m128i p = _mm_loadu_si128((const __m128i*)(taps[t] + i));
+                lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), w));
+                hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), w));
+            }
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = convolvePixel(taps, weights, tapCount, i);
+        }
+    }
+
+    void modulate(uint32* dst, const uint16* weights, int count)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16(128);
+
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            // Four weights, each spread over its pixel's four bytes.
+            __m128i w = _mm_loadl_epi64((const __m128i*)(weights + i));
+            w = _mm_unpacklo_epi16(w, w);
+            __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+            __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi32(w, w));
+            __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi32(w, w));
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, bias), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, bias), 8);
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = modulatePixel(dst[i], weights[i]);
+        }
+    }
+
+    void addSpan(uint32* dst, const uint32* src, int count)
+    {
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+            __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_adds_epu8(d, s));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = addPixel(dst[i], src[i]);
+        }
+    }
+
+    void subtractSpan(uint32* dst, const uint32* src, int count, uint32 value)
+    {
+        const __m128i v = _mm_set1_epi32((int)value);
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_subs_epu8(s, v));
+        }
+        for (; i < count; ++i)
+        {
+            dst[i] = subtractPixel(src[i], value);
+        }
+    }
+
+    const Kernels::Table cSSE2Table = {
+        Kernels::Level::SSE2,
+        fillSpan,
+        blendSpan,
+        expandPalette,
+        clear,
+        convert,
+        upscaleRow,
+        Kernels::Internal::applyLut, // no gather before AVX2
+        Kernels::Internal::applyCube,
+        convolve,
+        modulate,
+        addSpan,
+        subtractSpan,
+    };
+}
+
+const Kernels::Table* Kernels::Internal::sse2Table()
+{
+    return &cSSE2Table;
+}
+
+#else
+
+const Kernels::Table* Kernels::Internal::sse2Table()
+{
+    return nullptr;
+}
+
+#endif
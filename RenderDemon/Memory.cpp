@@ -0,0 +1,239 @@
+#include "Memory.h"
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // Every block is prefixed with a header so frees can be attributed to the
+    // tag and size of the original allocation. Padded to 16 bytes on 32- and
+    // 64-bit targets alike so the returned pointer stays aligned for any
+    // fundamental type.
+    struct Header
+    {
+        size_t size;
+        uint32 tag;
+        uint8 pad[16 - sizeof(size_t) - sizeof(uint32)];
+    };
+    static_assert(sizeof(Header) % 16 == 0, "allocation header must preserve alignment");
+
+    struct Counters
+    {
+        std::atomic<uint64> allocations;
+        std::atomic<uint64> frees;
+        std::atomic<uint64> bytes;
+        std::atomic<uint64> liveBytes;
+    };
+
+    Counters g_counters[(int)Memory::Tag::Count];
+    Memory::Stats g_frameStart[(int)Memory::Tag::Count];
+
+    std::atomic<bool> g_guard(false);
+    std::atomic<uint64> g_violations(0);
+
+    THREAD_LOCAL Memory::Tag t_tag = Memory::Tag::General;
+
+    void* trackedAlloc(size_t size)
+    {
+        Header* header = (Header*)malloc(sizeof(Header) + size);
+        if (!header)
+        {
+            return nullptr;
+        }
+
+        header->size = size;
+        header->tag = (uint32)t_tag;
+
+        Counters& c = g_counters[header->tag];
+        c.allocations.fetch_add(1, std::memory_order_relaxed);
+        c.bytes.fetch_add(size, std::memory_order_relaxed);
+        c.liveBytes.fetch_add(size, std::memory_order_relaxed);
+
+        if (g_guard.load(std::memory_order_relaxed))
+        {
+            g_violations.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return header + 1;
+    }
+
+    void trackedFree(void* ptr)
+    {
+        if (!ptr)
+        {
+            return;
+        }
+
+        Header* header = (Header*)ptr - 1;
+        Counters& c = g_counters[header->tag];
+        c.frees.fetch_add(1, std::memory_order_relaxed);
+        c.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+        free(header);
+    }
+
+    void* throwingAlloc(size_t size)
+    {
+        void* p = trackedAlloc(size);
+        if (!p)
+        {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+}
+
+void* operator new(size_t size) { return throwingAlloc(size); }
+void* operator new[](size_t size) { return throwingAlloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) throw() { return trackedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) throw() { return trackedAlloc(size); }
+void operator delete(void* ptr) throw() { trackedFree(ptr); }
+void operator delete[](void* ptr) throw() { trackedFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) throw() { trackedFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) throw() { trackedFree(ptr); }
+void operator delete(void* ptr, size_t) throw() { trackedFree(ptr); }
+void operator delete[](void* ptr, size_t) throw() { trackedFree(ptr); }
+
+namespace Memory
+{
+    const char* tagName(Tag tag)
+    {
+        switch (tag)
+        {
+        case Tag::General: return "general";
+        case Tag::Video: return "video";
+        case Tag::Input: return "input";
+        case Tag::Simulation: return "simulation";
+        default: return "unknown";
+        }
+    }
+
+    Scope::Scope(Tag tag)
+        : m_previous(t_tag)
+    {
+        t_tag = tag;
+    }
+
+    Scope::~Scope()
+    {
+        t_tag = m_previous;
+    }
+
+    Tag currentTag()
+    {
+        return t_tag;
+    }
+
+    Stats totalStats(Tag tag)
+    {
+        const Counters& c = g_counters[(int)tag];
+        Stats stats = {
+            c.allocations.load(std::memory_order_relaxed),
+            c.frees.load(std::memory_order_relaxed),
+            c.bytes.load(std::memory_order_relaxed),
+        };
+        return stats;
+    }
+
+    uint64 liveAllocations()
+    {
+        uint64 live = 0;
+        for (int i = 0; i < (int)Tag::Count; ++i)
+        {
+            Stats stats = totalStats((Tag)i);
+            live += stats.allocations - stats.frees;
+        }
+        return live;
+    }
+
+    uint64 liveBytes()
+    {
+        uint64 live = 0;
+        for (int i = 0; i < (int)Tag::Count; ++i)
+        {
+            live += g_counters[i].liveBytes.load(std::memory_order_relaxed);
+        }
+        return live;
+    }
+
+    void beginFrame()
+    {
+        for (int i = 0; i < (int)Tag::Count; ++i)
+        {
+            g_frameStart[i] = totalStats((Tag)i);
+        }
+    }
+
+    FrameStats frameStats()
+    {
+        FrameStats frame = {};
+        for (int i = 0; i < (int)Tag::Count; ++i)
+        {
+            Stats now = totalStats((Tag)i);
+            Stats& tag = frame.tags[i];
+            tag.allocations = now.allocations - g_frameStart[i].allocations;
+            tag.frees = now.frees - g_frameStart[i].frees;
+            tag.bytes = now.bytes - g_frameStart[i].bytes;
+
+            frame.total.allocations += tag.allocations;
+            frame.total.frees += tag.frees;
+            frame.total.bytes += tag.bytes;
+        }
+        return frame;
+    }
+
+    void setFrameGuard(bool enabled)
+    {
+        g_guard.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool frameGuard()
+    {
+        return g_guard.load(std::memory_order_relaxed);
+    }
+
+    uint64 guardViolations()
+    {
+        return g_violations.load(std::memory_order_relaxed);
+    }
+
+    void reportFrame(uint64 frame)
+    {
+        FrameStats stats = frameStats();
+        if (stats.total.allocations == 0)
+        {
+            return;
+        }
+
+        SDL_Log("frame %llu: %llu allocations, %llu bytes",
+            (unsigned long long)frame,
+            (unsigned long long)stats.total.allocations,
+            (unsigned long long)stats.total.bytes);
+
+        for (int i = 0; i < (int)Tag::Count; ++i)
+        {
+            if (stats.tags[i].allocations > 0)
+            {
+                SDL_Log("    %-10s %llu allocations, %llu bytes", tagName((Tag)i),
+                    (unsigned long long)stats.tags[i].allocations,
+                    (unsigned long long)stats.tags[i].bytes);
+            }
+        }
+    }
+
+    void reportLeaks()
+    {
+        for (int i = 0; i < (int)Tag::Count; ++i)
+        {
+            Stats stats = totalStats((Tag)i);
+            uint64 live = stats.allocations - stats.frees;
+            if (live > 0)
+            {
+                SDL_Log("leak: %-10s %llu blocks, %llu bytes", tagName((Tag)i),
+                    (unsigned long long)live,
+                    (unsigned long long)g_counters[i].liveBytes.load(std::memory_order_relaxed));
+            }
+        }
+    }
+}
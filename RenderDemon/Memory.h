@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Types.h"
+
+// Portable heap allocation tracker. Global operator new/delete are replaced
+// (see Memory.cpp) so every C++ allocation is counted against the subsystem
+// tag that is active on the allocating thread. Allocations made by SDL with
+// its own malloc are not visible here.
+namespace Memory
+{
+    enum class Tag
+    {
+        General,
+        Video,
+        Input,
+        Simulation,
+        Count,
+    };
+
+    const char* tagName(Tag tag);
+
+    struct Stats
+    {
+        uint64 allocations;
+        uint64 frees;
+        uint64 bytes;
+    };
+
+    struct FrameStats
+    {
+        Stats total;
+        Stats tags[(int)Tag::Count];
+    };
+
+    // RAII helper that attributes allocations on the current thread to a tag.
+    class Scope
+    {
+    public:
+        explicit Scope(Tag tag);
+        ~Scope();
+
+    private:
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+
+        Tag m_previous;
+    };
+
+    Tag currentTag();
+
+    // Lifetime totals and currently live allocations.
+    Stats totalStats(Tag tag);
+    uint64 liveAllocations();
+    uint64 liveBytes();
+
+    // Marks the start of a frame; frameStats() reports everything allocated since.
+    void beginFrame();
+    FrameStats frameStats();
+
+    // While the guard is enabled any allocation is recorded as a violation.
+    // Used to enforce that the steady-state frame loop never touches the heap.
+    void setFrameGuard(bool enabled);
+    bool frameGuard();
+    uint64 guardViolations();
+
+    void reportFrame(uint64 frame);
+    void reportLeaks();
+}
@@ -0,0 +1,184 @@
+#include "Pacing.h"
+#include "Util.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+    // Starting spin margin and the least it may shrink to, in microseconds.
+    const uint64 cInitialMarginUs = 2000;
+    const uint64 cMinMarginUs = 250;
+
+    // The margin is at most this fraction of the period, so some of every
+    // interval is always slept.
+    const uint64 cMaxMarginDivisor = 4;
+}
+
+const char* presentModeName(PresentMode mode)
+{
+    switch (mode)
+    {
+    case PresentMode::VSync: return "vsync";
+    case PresentMode::Uncapped: return "uncapped";
+    case PresentMode::Capped: return "capped";
+    default: return "unknown";
+    }
+}
+
+bool parsePresentMode(const char* name, PresentMode* mode)
+{
+    for (int i = 0; i < (int)PresentMode::Count; ++i)
+    {
+        if (strcmp(name, presentModeName((PresentMode)i)) == 0)
+        {
+            *mode = (PresentMode)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+FramePacer::FramePacer(f64 rate, int capacity)
+    : m_frequency(SDL_GetPerformanceFrequency()),
+    m_period(rate > 0.0 ? (uint64)((f64)m_frequency / rate) : 0),
+    m_deadline(0),
+    m_margin(Util::Min(m_frequency * cInitialMarginUs / 1000000, m_period / cMaxMarginDivisor)),
+    m_overshoot(m_margin),
+    m_slept(0),
+    m_spun(0),
+    m_restarts(0),
+    m_lastPresent(0),
+    m_intervals(0),
+    m_samples(capacity > 0 ? capacity : 1, 0.f),
+    m_next(0)
+{
+}
+
+f64 FramePacer::toMs(uint64 ticks) const
+{
+    return (f64)ticks * 1000.0 / (f64)m_frequency;
+}
+
+void FramePacer::wait()
+{
+    if (m_period == 0)
+    {
+        return;
+    }
+
+    uint64 now = SDL_GetPerformanceCounter();
+    if (m_deadline == 0 || now > m_deadline + m_period)
+    {
+        if (m_deadline != 0)
+        {
+            ++m_restarts;
+        }
+        m_deadline = now;
+    }
+
+    // Whole milliseconds are slept, as far as the margin allows; the worst
+    // overrun of this wait's sleeps feeds the smoothed overshoot.
+    uint64 worst = 0;
+    bool slept = false;
+    while (now + m_margin < m_deadline)
+    {
+        const uint64 request = m_deadline - m_margin - now;
+        const Uint32 ms = (Uint32)(request * 1000 / m_frequency);
+        if (ms == 0)
+        {
+            break;
+        }
+
+        SDL_Delay(ms);
+        const uint64 woke = SDL_GetPerformanceCounter();
+        const uint64 asked = (uint64)ms * m_frequency / 1000;
+        worst = Util::Max(worst, woke - now > asked ? woke - now - asked : 0);
+        slept = true;
+        m_slept += woke - now;
+        now = woke;
+    }
+
+    // Once per wait the margin covers the smoothed overshoot at once, and
+    // otherwise decays towards it, even when nothing was slept.
+    if (slept)
+    {
+        if (worst > m_overshoot)
+        {
+            m_overshoot += (worst - m_overshoot) / 8;
+        }
+        else
+        {
+            m_overshoot -= (m_overshoot - worst) / 8;
+        }
+    }
+    const uint64 minMargin = m_frequency * cMinMarginUs / 1000000;
+    m_margin = Util::Max(m_overshoot + m_overshoot / 4, m_margin - m_margin / 32);
+    m_margin = Util::Min(Util::Max(m_margin, minMargin), m_period / cMaxMarginDivisor);
+
+    const uint64 spinStart = now;
+    while (now < m_deadline)
+    {
+        std::this_thread::yield();
+        now = SDL_GetPerformanceCounter();
+    }
+    m_spun += now - spinStart;
+
+    m_deadline += m_period;
+}
+
+void FramePacer::presented()
+{
+    const uint64 now = SDL_GetPerformanceCounter();
+    if (m_lastPresent != 0)
+    {
+        m_samples[m_next] = (f32)toMs(now - m_lastPresent);
+        m_next = (m_next + 1) % (int)m_samples.size();
+        ++m_intervals;
+    }
+    m_lastPresent = now;
+}
+
+void FramePacer::report() const
+{
+    if (m_intervals == 0)
+    {
+        return;
+    }
+
+    int count = (int)Util::Min<uint64>(m_intervals, m_samples.size());
+    std::vector<f32> sorted(m_samples.begin(), m_samples.begin() + count);
+    std::sort(sorted.begin(), sorted.end());
+
+    f64 sum = 0.0;
+    for (f32 ms : sorted)
+    {
+        sum += ms;
+    }
+    const f64 mean = sum / count;
+
+    // Jitter is measured against the target interval when there is one.
+    const f64 target = m_period ? toMs(m_period) : mean;
+    f64 squares = 0.0;
+    f64 worst = 0.0;
+    for (f32 ms : sorted)
+    {
+        const f64 deviation = ms - target;
+        squares += deviation * deviation;
+        worst = Util::Max(worst, fabs(deviation));
+    }
+
+    auto percentile = [&](f64 p) { return sorted[Util::Min((int)(p * (count - 1) + 0.5), count - 1)]; };
+
+    SDL_Log("benchmark: frame interval mean %.3f  p1 %.3f  p50 %.3f  p99 %.3f ms (last %d frames)",
+        mean, percentile(0.01), percentile(0.50), percentile(0.99), count);
+    SDL_Log("benchmark: interval jitter rms %.3f  max %.3f ms from %.3f ms", sqrt(squares / count), worst, target);
+    if (m_period)
+    {
+        SDL_Log("benchmark: limiter slept %.1f ms, spun %.1f ms (margin %.3f ms), %llu schedule restarts",
+            toMs(m_slept), toMs(m_spun), toMs(m_margin), (unsigned long long)m_restarts);
+    }
+}
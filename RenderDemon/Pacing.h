@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Types.h"
+
+#include <vector>
+
+// How finished frames are paced: by the display's vblank, not at all, or
+// by FramePacer at a fixed rate with vsync off.
+enum class PresentMode
+{
+    VSync,
+    Uncapped,
+    Capped,
+    Count,
+};
+
+const char* presentModeName(PresentMode mode);
+bool parsePresentMode(const char* name, PresentMode* mode);
+
+// Frame limiter and interval statistics. wait() holds each frame back until
+// its slot on a fixed schedule: it sleeps while the deadline is comfortably
+// far off and spins through the last stretch, whose length tracks how late
+// the OS has been waking the thread on average, up to a quarter of the
+// period, so frames land on time without burning a core for the interval. A frame that misses its slot by more than
+// a whole period restarts the schedule rather than rushing to catch up.
+class FramePacer
+{
+public:
+    // rate 0 never waits and only measures. capacity bounds how many
+    // intervals are kept for percentiles.
+    FramePacer(f64 rate, int capacity);
+
+    void wait();
+
+    // Call as each frame's present returns; records the interval since the
+    // previous one.
+    void presented();
+
+    void report() const;
+
+private:
+    f64 toMs(uint64 ticks) const;
+
+    uint64 m_frequency;
+    uint64 m_period; // 0 when uncapped
+    uint64 m_deadline;
+    uint64 m_margin; // spun rather than slept before a deadline
+    uint64 m_overshoot; // smoothed time sleeps ran past what was asked
+    uint64 m_slept;
+    uint64 m_spun;
+    uint64 m_restarts;
+
+    uint64 m_lastPresent;
+    uint64 m_intervals;
+    std::vector<f32> m_samples;
+    int m_next;
+};
@@ -0,0 +1,277 @@
+#include "Palette.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    const int cBins = 32 * 32 * 32;
+
+    int binOf(uint32 argb)
+    {
+        return (((argb >> 19) & 0x1F) << 10) | (((argb >> 11) & 0x1F) << 5) | ((argb >> 3) & 0x1F);
+    }
+
+    // Histogram cells, 5 bits per channel, in r g b order.
+    int binChannel(int bin, int channel)
+    {
+        return (bin >> (10 - 5 * channel)) & 0x1F;
+    }
+
+    struct Box
+    {
+        int begin, end; // range of the sorted cell list
+        int pixels;
+        int lo[3], hi[3];
+    };
+
+    void shrink(Box& box, const std::vector<int>& cells)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            box.lo[c] = 31;
+            box.hi[c] = 0;
+        }
+        for (int i = box.begin; i < box.end; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                int v = binChannel(cells[i], c);
+                box.lo[c] = Util::Min(box.lo[c], v);
+                box.hi[c] = Util::Max(box.hi[c], v);
+            }
+        }
+    }
+
+    int widestChannel(const Box& box)
+    {
+        int widest = 0;
+        for (int c = 1; c < 3; ++c)
+        {
+            if (box.hi[c] - box.lo[c] > box.hi[widest] - box.lo[widest])
+            {
+                widest = c;
+            }
+        }
+        return widest;
+    }
+}
+
+PaletteLut::PaletteLut()
+{
+    memset(m_table, 0, sizeof(m_table));
+}
+
+void PaletteLut::build(const SDL_Color* palette, int count)
+{
+    count = Util::Min(count, 256);
+    for (int cell = 0; cell < cBins; ++cell)
+    {
+        SDL_Color centre;
+        centre.r = (uint8)((binChannel(cell, 0) << 3) | 4);
+        centre.g = (uint8)((binChannel(cell, 1) << 3) | 4);
+        centre.b = (uint8)((binChannel(cell, 2) << 3) | 4);
+        centre.a = 255;
+        m_table[cell] = (uint8)Palette::nearest(palette, count, centre);
+    }
+}
+
+void PaletteLut::map(uint8* dst, const uint32* src, int count, bool redLow) const
+{
+    if (!redLow)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i] = m_table[binOf(src[i])];
+        }
+        return;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        const uint32 p = src[i];
+        dst[i] = m_table[((p & 0xF8) << 7) | ((p >> 6) & 0x3E0) | ((p >> 19) & 0x1F)];
+    }
+}
+
+int Palette::nearest(const SDL_Color* palette, int count, const SDL_Color& color)
+{
+    int best = 0;
+    int bestDistance = INT_MAX;
+    for (int i = 0; i < count; ++i)
+    {
+        int dr = palette[i].r - color.r;
+        int dg = palette[i].g - color.g;
+        int db = palette[i].b - color.b;
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance < bestDistance)
+        {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+int Palette::medianCut(const uint32* argb, int count, SDL_Color* palette, int maxColors)
+{
+    maxColors = Util::Max(1, Util::Min(maxColors, 256));
+
+    // Counts and channel sums per cell, so entries are means of the real
+    // colors rather than of cell centres.
+    std::vector<int> histogram(cBins, 0);
+    std::vector<uint64> sums(cBins * 3, 0);
+    for (int i = 0; i < count; ++i)
+    {
+        int bin = binOf(argb[i]);
+        ++histogram[bin];
+        sums[bin * 3 + 0] += (argb[i] >> 16) & 0xFF;
+        sums[bin * 3 + 1] += (argb[i] >> 8) & 0xFF;
+        sums[bin * 3 + 2] += argb[i] & 0xFF;
+    }
+
+    // Boxes own contiguous ranges of the occupied cells, so a split is a
+    // sort of the range on one channel and a cut at the pixel median.
+    std::vector<int> cells;
+    for (int cell = 0; cell < cBins; ++cell)
+    {
+        if (histogram[cell] > 0)
+        {
+            cells.push_back(cell);
+        }
+    }
+    if (cells.empty())
+    {
+        return 0;
+    }
+
+    std::vector<Box> boxes;
+    Box all = { 0, (int)cells.size(), count, { 0, 0, 0 }, { 0, 0, 0 } };
+    shrink(all, cells);
+    boxes.push_back(all);
+
+    while ((int)boxes.size() < maxColors)
+    {
+        // The splittable box with the widest range, larger populations first on ties.
+        int pick = -1;
+        int pickRange = 0;
+        for (int i = 0; i < (int)boxes.size(); ++i)
+        {
+            const Box& box = boxes[i];
+            if (box.end - box.begin < 2)
+            {
+                continue;
+            }
+            int c = widestChannel(box);
+            int range = box.hi[c] - box.lo[c];
+            if (pick < 0 || range > pickRange || (range == pickRange && box.pixels > boxes[pick].pixels))
+            {
+                pick = i;
+                pickRange = range;
+            }
+        }
+        if (pick < 0)
+        {
+            break;
+        }
+
+        Box box = boxes[pick];
+        const int channel = widestChannel(box);
+        std::sort(cells.begin() + box.begin, cells.begin() + box.end, [&](int a, int b)
+        {
+            int va = binChannel(a, channel), vb = binChannel(b, channel);
+            return va != vb ? va < vb : a < b;
+        });
+
+        // First cell past half the pixels, keeping at least one cell each side.
+        int split = box.begin + 1;
+        int seen = histogram[cells[box.begin]];
+        while (split < box.end - 1 && seen * 2 < box.pixels)
+        {
+            seen += histogram[cells[split++]];
+        }
+
+        Box low = box;
+        Box high = box;
+        low.end = split;
+        low.pixels = seen;
+        high.begin = split;
+        high.pixels = box.pixels - seen;
+        shrink(low, cells);
+        shrink(high, cells);
+        boxes[pick] = low;
+        boxes.push_back(high);
+    }
+
+    for (int i = 0; i < (int)boxes.size(); ++i)
+    {
+        uint64 sum[3] = { 0, 0, 0 };
+        uint64 pixels = 0;
+        for (int j = boxes[i].begin; j < boxes[i].end; ++j)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                sum[c] += sums[cells[j] * 3 + c];
+            }
+            pixels += histogram[cells[j]];
+        }
+        palette[i].r = (uint8)((sum[0] + pixels / 2) / pixels);
+        palette[i].g = (uint8)((sum[1] + pixels / 2) / pixels);
+        palette[i].b = (uint8)((sum[2] + pixels / 2) / pixels);
+        palette[i].a = 255;
+    }
+    return (int)boxes.size();
+}
+
+void ColorMaps::build(const SDL_Color* palette, int count, const PaletteLut& lut)
+{
+    count = Util::Min(count, 256);
+
+    // Entries past count read as black, like the canvas's padded palette.
+    SDL_Color colors[256];
+    for (int i = 0; i < 256; ++i)
+    {
+        const SDL_Color cBlack = { 0, 0, 0, 255 };
+        colors[i] = i < count ? palette[i] : cBlack;
+    }
+
+    for (int level = 0; level < cTranslucencyLevels; ++level)
+    {
+        const int weight = level + 1; // quarters of the source
+        uint8* map = m_translucency[level];
+        for (int s = 0; s < 256; ++s)
+        {
+            for (int d = 0; d < 256; ++d)
+            {
+                const SDL_Color& a = colors[s];
+                const SDL_Color& b = colors[d];
+                map[s * 256 + d] = lut.index((uint8)((a.r * weight + b.r * (4 - weight) + 2) / 4),
+                    (uint8)((a.g * weight + b.g * (4 - weight) + 2) / 4),
+                    (uint8)((a.b * weight + b.b * (4 - weight) + 2) / 4));
+            }
+        }
+    }
+
+    for (int level = 0; level < cLightLevels; ++level)
+    {
+        const int scale = cLightLevels - level;
+        for (int i = 0; i < 256; ++i)
+        {
+            SDL_Color c = colors[i];
+            c.r = (uint8)((c.r * scale + cLightLevels / 2) / cLightLevels);
+            c.g = (uint8)((c.g * scale + cLightLevels / 2) / cLightLevels);
+            c.b = (uint8)((c.b * scale + cLightLevels / 2) / cLightLevels);
+            m_light[level][i] = (uint8)Palette::nearest(colors, count, c);
+        }
+    }
+}
+
+int ColorMaps::translucencyLevel(uint8 alpha)
+{
+    // Quarters, rounded; fully transparent and opaque clamp to the ends.
+    int quarters = (alpha * 4 + 127) / 255;
+    return Util::Clamp(quarters, 1, cTranslucencyLevels) - 1;
+}
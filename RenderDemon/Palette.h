@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Types.h"
+
+#include <SDL2/SDL.h>
+
+// Maps RGB colors to palette indices in constant time through a 32x32x32
+// table: each cell holds the palette entry nearest its centre. Building it
+// costs one nearest-color search per cell, so it is rebuilt only when the
+// palette changes. Lookups drop the low 3 bits of each channel, so colors
+// within a cell of two entries may map to the further one.
+class PaletteLut
+{
+public:
+    PaletteLut();
+
+    void build(const SDL_Color* palette, int count);
+
+    uint8 index(uint8 r, uint8 g, uint8 b) const
+    {
+        return m_table[((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3)];
+    }
+
+    // Whole images: dst[i] = index of src[i], alpha ignored. redLow says
+    // whether R is in the low byte of src (ABGR8888) or the third (ARGB8888).
+    void map(uint8* dst, const uint32* src, int count, bool redLow) const;
+
+private:
+    uint8 m_table[32 * 32 * 32];
+};
+
+namespace Palette
+{
+    // Exact nearest entry by squared RGB distance; the first wins ties.
+    int nearest(const SDL_Color* palette, int count, const SDL_Color& color);
+
+    // Median cut over a 5-bit-per-channel histogram of argb (alpha ignored).
+    // Boxes with the widest channel range are split at their pixel median
+    // until there are maxColors (at most 256); each entry is the mean of its
+    // box. Returns the number of entries written, fewer if the image has
+    // fewer distinct colors.
+    int medianCut(const uint32* argb, int count, SDL_Color* palette, int maxColors);
+}
+
+// Doom-style lookup tables for indexed rendering, built from one palette:
+// a 256x256 translucency map (TRANMAP) per blend level and a colormap per
+// light level. Each turns blending or shading a pixel into a byte lookup.
+class ColorMaps
+{
+public:
+    static const int cTranslucencyLevels = 3; // 25%, 50% and 75% source
+    static const int cLightLevels = 32;
+
+    // Blended colors are matched through lut; light levels search the
+    // palette exactly, as there are only 256 entries per level.
+    void build(const SDL_Color* palette, int count, const PaletteLut& lut);
+
+    // Nearest translucency level for a draw alpha below 255.
+    static int translucencyLevel(uint8 alpha);
+
+    // translucency(level)[source * 256 + dest] is the blend of the two indices.
+    const uint8* translucency(int level) const { return m_translucency[level]; }
+    // light(level)[index] is index darkened by level / cLightLevels; level 0 is full bright.
+    const uint8* light(int level) const { return m_light[level]; }
+
+private:
+    uint8 m_translucency[cTranslucencyLevels][256 * 256];
+    uint8 m_light[cLightLevels][256];
+};
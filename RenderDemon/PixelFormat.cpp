@@ -0,0 +1,26 @@
+#include "PixelFormat.h"
+
+const char* pixelFormatName(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::ARGB8888: return "argb8888";
+    case PixelFormat::ABGR8888: return "abgr8888";
+    case PixelFormat::RGB565: return "rgb565";
+    case PixelFormat::Indexed8: return "indexed8";
+    default: return "unknown";
+    }
+}
+
+bool parsePixelFormat(const char* name, PixelFormat* format)
+{
+    for (int i = 0; i < (int)PixelFormat::Count; ++i)
+    {
+        if (strcmp(name, pixelFormatName((PixelFormat)i)) == 0)
+        {
+            *format = (PixelFormat)i;
+            return true;
+        }
+    }
+    return false;
+}
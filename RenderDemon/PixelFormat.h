@@ -0,0 +1,196 @@
+#pragma once
+
+#include "Types.h"
+#include "Kernels.h"
+#include "ColorGrade.h"
+
+#include <SDL2/SDL.h>
+#include <cstring>
+
+enum class PixelFormat
+{
+    ARGB8888,
+    ABGR8888, // R in the low byte; the original framebuffer layout
+    RGB565,
+    Indexed8,
+    Count,
+};
+
+const char* pixelFormatName(PixelFormat format);
+bool parsePixelFormat(const char* name, PixelFormat* format);
+
+// Compile-time description of a framebuffer layout. Canvas's drawing core is
+// instantiated once per traits type, so packing, stores and readback have no
+// per-pixel branches or runtime BytesPerPixel arithmetic.
+//
+// Every traits type provides:
+//   Pixel                 storage type of one pixel
+//   cBitsPerPixel, masks  what SDL_CreateRGBSurface needs
+//   cTextureFormat        streaming texture format present() uploads into
+//   TexturePixel          storage type of one texture pixel
+//   cUploadIsCopy         surface rows are already in texture format
+//   pack(color)           packs an RGB color (not used for Indexed8)
+//   unpack(p, palette)    reads a pixel back as RGB
+//   fill / blend          span writes of an already packed value
+//   average(a, b)         per-channel mean, used to fill in interlaced pixels
+//   upload                converts one row into the texture, graded if a
+//                         ColorGrade is given (Indexed8 grades its palette)
+struct FormatARGB8888
+{
+    typedef uint32 Pixel;
+    static const PixelFormat cFormat = PixelFormat::ARGB8888;
+    static const int cBitsPerPixel = 32;
+    static const uint32 cRmask = 0x00FF0000;
+    static const uint32 cGmask = 0x0000FF00;
+    static const uint32 cBmask = 0x000000FF;
+    static const uint32 cTextureFormat = SDL_PIXELFORMAT_ARGB8888;
+    typedef uint32 TexturePixel;
+    static const bool cUploadIsCopy = true;
+
+    static uint32 pack(const SDL_Color& c) { return ((uint32)c.r << 16) | ((uint32)c.g << 8) | c.b; }
+
+    static SDL_Color unpack(Pixel p, const SDL_Color*)
+    {
+        SDL_Color c = { (uint8)(p >> 16), (uint8)(p >> 8), (uint8)p, 255 };
+        return c;
+    }
+
+    static void fill(const Kernels::Table& k, Pixel* dst, int count, uint32 value) { k.fillSpan(dst, count, value); }
+    static void blend(const Kernels::Table& k, Pixel* dst, int count, uint32 value, uint32 alpha) { k.blendSpan(dst, count, value, alpha); }
+    static Pixel average(Pixel a, Pixel b) { return (a & b) + (((a ^ b) & 0xFEFEFEFE) >> 1); }
+
+    static void upload(const Kernels::Table& k, void* dst, const Pixel* src, int count, const uint32*, const ColorGrade* grade)
+    {
+        if (grade)
+        {
+            grade->apply(k, (uint32*)dst, src, count, false);
+            return;
+        }
+        memcpy(dst, src, count * sizeof(Pixel));
+    }
+};
+
+struct FormatABGR8888
+{
+    typedef uint32 Pixel;
+    static const PixelFormat cFormat = PixelFormat::ABGR8888;
+    static const int cBitsPerPixel = 32;
+    static const uint32 cRmask = 0x000000FF;
+    static const uint32 cGmask = 0x0000FF00;
+    static const uint32 cBmask = 0x00FF0000;
+    static const uint32 cTextureFormat = SDL_PIXELFORMAT_ARGB8888;
+    typedef uint32 TexturePixel;
+    static const bool cUploadIsCopy = false;
+
+    static uint32 pack(const SDL_Color& c) { return c.r | ((uint32)c.g << 8) | ((uint32)c.b << 16); }
+
+    static SDL_Color unpack(Pixel p, const SDL_Color*)
+    {
+        SDL_Color c = { (uint8)p, (uint8)(p >> 8), (uint8)(p >> 16), 255 };
+        return c;
+    }
+
+    static void fill(const Kernels::Table& k, Pixel* dst, int count, uint32 value) { k.fillSpan(dst, count, value); }
+    static void blend(const Kernels::Table& k, Pixel* dst, int count, uint32 value, uint32 alpha) { k.blendSpan(dst, count, value, alpha); }
+    static Pixel average(Pixel a, Pixel b) { return (a & b) + (((a ^ b) & 0xFEFEFEFE) >> 1); }
+
+    static void upload(const Kernels::Table& k, void* dst, const Pixel* src, int count, const uint32*, const ColorGrade* grade)
+    {
+        // The grade tables are indexed by source byte, so grading also does the swizzle.
+        if (grade)
+        {
+            grade->apply(k, (uint32*)dst, src, count, true);
+            return;
+        }
+        k.convert((uint32*)dst, src, count);
+    }
+};
+
+struct FormatRGB565
+{
+    typedef uint16 Pixel;
+    static const PixelFormat cFormat = PixelFormat::RGB565;
+    static const int cBitsPerPixel = 16;
+    static const uint32 cRmask = 0xF800;
+    static const uint32 cGmask = 0x07E0;
+    static const uint32 cBmask = 0x001F;
+    static const uint32 cTextureFormat = SDL_PIXELFORMAT_RGB565;
+    typedef uint16 TexturePixel;
+    static const bool cUploadIsCopy = true;
+
+    static uint32 pack(const SDL_Color& c) { return ((uint32)(c.r >> 3) << 11) | ((uint32)(c.g >> 2) << 5) | (c.b >> 3); }
+
+    static SDL_Color unpack(Pixel p, const SDL_Color*)
+    {
+        uint8 r = (p >> 11) & 0x1F;
+        uint8 g = (p >> 5) & 0x3F;
+        uint8 b = p & 0x1F;
+        SDL_Color c = { (uint8)((r << 3) | (r >> 2)), (uint8)((g << 2) | (g >> 4)), (uint8)((b << 3) | (b >> 2)), 255 };
+        return c;
+    }
+
+    static void fill(const Kernels::Table&, Pixel* dst, int count, uint32 value)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i] = (Pixel)value;
+        }
+    }
+
+    static void blend(const Kernels::Table&, Pixel* dst, int count, uint32 value, uint32 alpha)
+    {
+        SDL_Color s = unpack((Pixel)value, nullptr);
+        uint32 color = s.r | ((uint32)s.g << 8) | ((uint32)s.b << 16);
+        for (int i = 0; i < count; ++i)
+        {
+            SDL_Color d = unpack(dst[i], nullptr);
+            uint32 mixed = Kernels::Internal::blendPixel(color, d.r | ((uint32)d.g << 8) | ((uint32)d.b << 16), alpha);
+            SDL_Color m = { (uint8)mixed, (uint8)(mixed >> 8), (uint8)(mixed >> 16), 255 };
+            dst[i] = (Pixel)pack(m);
+        }
+    }
+
+    static Pixel average(Pixel a, Pixel b) { return (Pixel)((a & b) + (((a ^ b) & 0xF7DE) >> 1)); }
+
+    static void upload(const Kernels::Table&, void* dst, const Pixel* src, int count, const uint32*, const ColorGrade* grade)
+    {
+        if (grade)
+        {
+            grade->apply565((uint16*)dst, src, count);
+            return;
+        }
+        memcpy(dst, src, count * sizeof(Pixel));
+    }
+};
+
+// Pixels are palette indices; packed values are indices chosen by Canvas.
+struct FormatIndexed8
+{
+    typedef uint8 Pixel;
+    static const PixelFormat cFormat = PixelFormat::Indexed8;
+    static const int cBitsPerPixel = 8;
+    static const uint32 cRmask = 0;
+    static const uint32 cGmask = 0;
+    static const uint32 cBmask = 0;
+    static const uint32 cTextureFormat = SDL_PIXELFORMAT_ARGB8888;
+    typedef uint32 TexturePixel;
+    static const bool cUploadIsCopy = false;
+
+    static uint32 pack(const SDL_Color&) { return 0; }
+
+    static SDL_Color unpack(Pixel p, const SDL_Color* palette) { return palette[p]; }
+
+    static void fill(const Kernels::Table&, Pixel* dst, int count, uint32 value) { memset(dst, (int)value, count); }
+
+    // Canvas blends indexed spans through its palette's translucency maps;
+    // without them spans are drawn opaque.
+    static void blend(const Kernels::Table& k, Pixel* dst, int count, uint32 value, uint32) { fill(k, dst, count, value); }
+
+    // Indices cannot be averaged without a palette lookup; take a neighbour.
+    static Pixel average(Pixel a, Pixel) { return a; }
+
+    static void upload(const Kernels::Table& k, void* dst, const Pixel* src, int count, const uint32* palette, const ColorGrade*)
+    {
+        k.expandPalette((uint32*)dst, src, count, palette);
+    }
+};
@@ -0,0 +1,359 @@
+#include "PostProcess.h"
+#include "Canvas.h"
+#include "Memory.h"
+#include "Jobs.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    int clampRadius(int radius)
+    {
+        if (radius < 1)
+        {
+            return 1;
+        }
+        return radius > PostChain::cMaxRadius ? PostChain::cMaxRadius : radius;
+    }
+
+    // Scales weights to sum to total exactly; the rounding error goes to the
+    // centre tap so the kernel stays symmetric.
+    void normalize(const f32* weights, int radius, int total, uint16* out)
+    {
+        const int taps = 2 * radius + 1;
+        f32 sum = 0.f;
+        for (int t = 0; t < taps; ++t)
+        {
+            sum += weights[t];
+        }
+
+        int used = 0;
+        for (int t = 0; t < taps; ++t)
+        {
+            out[t] = (uint16)floorf(weights[t] * total / sum + 0.5f);
+            used += out[t];
+        }
+        out[radius] = (uint16)(out[radius] + total - used);
+    }
+}
+
+PostChain::PostChain(int width, int height, JobSystem& jobs)
+    : m_width(width),
+    m_height(height),
+    m_jobs(&jobs),
+    m_passCount(0),
+    m_vignetteWidth(0),
+    m_vignettePercent(-1)
+{
+    Memory::Scope memoryScope(Memory::Tag::Video);
+
+    // A few bands per thread so a slow one does not hold up the rest.
+    m_bands = std::max(1, std::min(height, jobs.threads() * 4));
+
+    m_planeSize = width * height;
+    m_bandStride = width + 2 * cMaxRadius;
+    m_scratch.resize(m_planeSize + m_bands * m_bandStride);
+    m_vignetteX.resize(width);
+}
+
+PostChain::Pass* PostChain::addPass(Type type, int radius, int amount)
+{
+    if (m_passCount == cMaxPasses)
+    {
+        SDL_Log("post: more than %d passes", cMaxPasses);
+        return nullptr;
+    }
+
+    Pass* pass = &m_passes[m_passCount++];
+    pass->type = type;
+    pass->radius = radius;
+    pass->amount = amount;
+    return pass;
+}
+
+void PostChain::addBoxBlur(int radius)
+{
+    radius = clampRadius(radius);
+    if (Pass* pass = addPass(Type::Blur, radius, 0))
+    {
+        f32 weights[2 * cMaxRadius + 1];
+        std::fill(weights, weights + 2 * radius + 1, 1.f);
+        normalize(weights, radius, 256, pass->weights);
+    }
+}
+
+void PostChain::addGaussianBlur(int radius)
+{
+    radius = clampRadius(radius);
+    if (Pass* pass = addPass(Type::Blur, radius, 0))
+    {
+        // Sigma of radius / 2 puts the cut-off at two standard deviations.
+        const f32 sigma = radius * 0.5f;
+        f32 weights[2 * cMaxRadius + 1];
+        for (int t = -radius; t <= radius; ++t)
+        {
+            weights[t + radius] = expf(-(f32)(t * t) / (2.f * sigma * sigma));
+        }
+        normalize(weights, radius, 256, pass->weights);
+    }
+}
+
+void PostChain::addBloom(uint8 threshold, int radius, int strengthPercent)
+{
+    radius = clampRadius(radius);
+    strengthPercent = std::max(0, std::min(strengthPercent, 100));
+    if (Pass* pass = addPass(Type::Bloom, radius, threshold))
+    {
+        const f32 sigma = radius * 0.5f;
+        f32 weights[2 * cMaxRadius + 1];
+        for (int t = -radius; t <= radius; ++t)
+        {
+            weights[t + radius] = expf(-(f32)(t * t) / (2.f * sigma * sigma));
+        }
+        normalize(weights, radius, 256, pass->weights);
+        normalize(weights, radius, 256 * strengthPercent / 100, pass->bloomWeights);
+    }
+}
+
+void PostChain::addScanlines(int percent)
+{
+    percent = std::max(0, std::min(percent, 100));
+    addPass(Type::Scanlines, 0, percent * 255 / 100);
+}
+
+void PostChain::addVignette(int percent)
+{
+    addPass(Type::Vignette, 0, std::max(0, std::min(percent, 100)));
+}
+
+bool PostChain::parse(const char* spec)
+{
+    const char* p = spec;
+    while (*p)
+    {
+        char name[16];
+        int length = (int)strcspn(p, ":,");
+        if (length == 0 || length >= (int)sizeof(name))
+        {
+            SDL_Log("post: bad pass list '%s'", spec);
+            return false;
+        }
+        memcpy(name, p, length);
+        name[length] = '\0';
+        p += length;
+
+        int value = -1;
+        if (*p == ':')
+        {
+            char* end;
+            value = (int)strtol(p + 1, &end, 10);
+            p = end;
+        }
+
+        if (strcmp(name, "box") == 0) { addBoxBlur(value < 0 ? 1 : value); }
+        else if (strcmp(name, "gauss") == 0) { addGaussianBlur(value < 0 ? 2 : value); }
+        else if (strcmp(name, "bloom") == 0) { addBloom((uint8)(value < 0 ? 192 : std::min(value, 255)), 4, 100); }
+        else if (strcmp(name, "scanlines") == 0) { addScanlines(value < 0 ? 50 : value); }
+        else if (strcmp(name, "vignette") == 0) { addVignette(value < 0 ? 50 : value); }
+        else
+        {
+            SDL_Log("post: unknown pass '%s'", name);
+            return false;
+        }
+
+        if (*p == ',')
+        {
+            ++p;
+        }
+        else if (*p)
+        {
+            SDL_Log("post: bad pass list '%s'", spec);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PostChain::run(Canvas& canvas)
+{
+    if (canvas.format() != PixelFormat::ARGB8888 && canvas.format() != PixelFormat::ABGR8888)
+    {
+        return false;
+    }
+
+    Job job;
+    job.chain = this;
+    job.kernels = &canvas.kernels();
+    job.pixels = (uint8*)canvas.pixels();
+    job.pitch = canvas.pitch();
+    job.width = std::min(canvas.renderWidth(), m_width);
+    job.height = std::min(canvas.renderHeight(), m_height);
+    const int bands = std::min(m_bands, job.height);
+
+    for (int i = 0; i < m_passCount; ++i)
+    {
+        job.pass = &m_passes[i];
+        job.vertical = false;
+        if (job.pass->type == Type::Vignette)
+        {
+            buildVignette(job.width, job.pass->amount);
+        }
+
+        // Separable passes need every horizontal row before the vertical
+        // pass reads its neighbours, so they run the bands twice.
+        m_jobs->parallelFor(bands, 1, runBands, &job);
+        if (job.pass->type == Type::Blur || job.pass->type == Type::Bloom)
+        {
+            job.vertical = true;
+            m_jobs->parallelFor(bands, 1, runBands, &job);
+        }
+    }
+    return true;
+}
+
+void PostChain::runBands(void* context, int begin, int end)
+{
+    const Job& job = *(const Job*)context;
+    PostChain* chain = job.chain;
+    const int bands = std::min(chain->m_bands, job.height);
+
+    for (int band = begin; band < end; ++band)
+    {
+        const int y0 = job.height * band / bands;
+        const int y1 = job.height * (band + 1) / bands;
+
+        switch (job.pass->type)
+        {
+        case Type::Blur:
+        case Type::Bloom:
+            if (job.vertical)
+            {
+                chain->vertical(job, band, y0, y1);
+            }
+            else
+            {
+                chain->horizontal(job, band, y0, y1);
+            }
+            break;
+        case Type::Scanlines:
+            chain->scanlines(job, y0, y1);
+            break;
+        case Type::Vignette:
+            chain->vignette(job, band, y0, y1);
+            break;
+        }
+    }
+}
+
+void PostChain::horizontal(const Job& job, int band, int y0, int y1)
+{
+    const Pass& pass = *job.pass;
+    const int r = pass.radius;
+    const int w = job.width;
+    uint32* padded = bandRow(band);
+
+    const uint32* taps[2 * cMaxRadius + 1];
+    for (int t = 0; t <= 2 * r; ++t)
+    {
+        taps[t] = padded + t;
+    }
+
+    for (int y = y0; y < y1; ++y)
+    {
+        // The row goes into the band's scratch with r edge pixels repeated
+        // on either side, so every tap is a plain offset pointer.
+        const uint32* src = (const uint32*)(job.pixels + y * job.pitch);
+        if (pass.type == Type::Bloom)
+        {
+            job.kernels->subtractSpan(padded + r, src, w, pass.amount * 0x01010101u);
+        }
+        else
+        {
+            memcpy(padded + r, src, w * sizeof(uint32));
+        }
+        std::fill(padded, padded + r, padded[r]);
+        std::fill(padded + r + w, padded + 2 * r + w, padded[r + w - 1]);
+
+        job.kernels->convolve(&m_scratch[y * m_width], taps, pass.weights, 2 * r + 1, w);
+    }
+}
+
+void PostChain::vertical(const Job& job, int band, int y0, int y1)
+{
+    const Pass& pass = *job.pass;
+    const int r = pass.radius;
+    const int w = job.width;
+    uint32* row = bandRow(band);
+
+    const uint32* taps[2 * cMaxRadius + 1];
+    for (int y = y0; y < y1; ++y)
+    {
+        for (int t = 0; t <= 2 * r; ++t)
+        {
+            int sy = std::max(0, std::min(y + t - r, job.height - 1));
+            taps[t] = &m_scratch[sy * m_width];
+        }
+
+        uint32* dst = (uint32*)(job.pixels + y * job.pitch);
+        if (pass.type == Type::Bloom)
+        {
+            job.kernels->convolve(row, taps, pass.bloomWeights, 2 * r + 1, w);
+            job.kernels->addSpan(dst, row, w);
+        }
+        else
+        {
+            job.kernels->convolve(dst, taps, pass.weights, 2 * r + 1, w);
+        }
+    }
+}
+
+void PostChain::scanlines(const Job& job, int y0, int y1)
+{
+    for (int y = y0 | 1; y < y1; y += 2)
+    {
+        job.kernels->blendSpan((uint32*)(job.pixels + y * job.pitch), job.width, 0, job.pass->amount);
+    }
+}
+
+int PostChain::vignetteFalloff(int i, int size) const
+{
+    // Quadratic in the distance from the centre. Rows and columns multiply,
+    // so each axis takes the square root of the corner brightness.
+    const f32 edge = 1.f - sqrtf(1.f - m_vignettePercent / 100.f);
+    const f32 u = size > 1 ? (2.f * i - (size - 1)) / (f32)(size - 1) : 0.f;
+    return (int)floorf(256.f * (1.f - edge * u * u) + 0.5f);
+}
+
+void PostChain::buildVignette(int width, int percent)
+{
+    if (width == m_vignetteWidth && percent == m_vignettePercent)
+    {
+        return;
+    }
+
+    m_vignetteWidth = width;
+    m_vignettePercent = percent;
+    for (int x = 0; x < width; ++x)
+    {
+        m_vignetteX[x] = (uint16)vignetteFalloff(x, width);
+    }
+}
+
+void PostChain::vignette(const Job& job, int band, int y0, int y1)
+{
+    // The band row holds this row's weights: columns times the row falloff.
+    uint16* weights = (uint16*)bandRow(band);
+    for (int y = y0; y < y1; ++y)
+    {
+        const int fy = vignetteFalloff(y, job.height);
+        for (int x = 0; x < job.width; ++x)
+        {
+            weights[x] = (uint16)((m_vignetteX[x] * fy + 128) >> 8);
+        }
+        job.kernels->modulate((uint32*)(job.pixels + y * job.pitch), weights, job.width);
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Types.h"
+#include "Kernels.h"
+
+#include <vector>
+
+class Canvas;
+class JobSystem;
+
+// Whole-frame effects run on a canvas after drawing and before present().
+// Passes work on 32-bit surfaces through the kernel table, one row at a
+// time, with rows split into bands across the job system. Blurs are separable:
+// a horizontal pass into a shared scratch plane, then a vertical pass back.
+// Every table the passes need is built when they are added, so run() does
+// not allocate.
+class PostChain
+{
+public:
+    static const int cMaxPasses = 8;
+    static const int cMaxRadius = 8;
+
+    // width and height bound the canvases the chain will run on. The job
+    // system is not owned and must outlive the chain.
+    PostChain(int width, int height, JobSystem& jobs);
+
+    // Radii are clamped to [1, cMaxRadius].
+    void addBoxBlur(int radius);
+    void addGaussianBlur(int radius);
+    // Channels above threshold are blurred and added back over the frame.
+    void addBloom(uint8 threshold, int radius, int strengthPercent);
+    // Darkens every odd row by percent.
+    void addScanlines(int percent);
+    // Darkens towards the edges; the corners lose percent of their brightness.
+    void addVignette(int percent);
+
+    // Appends passes from a comma-separated list of name[:value], e.g.
+    // "gauss:2,bloom:200,scanlines:40,vignette". Names are box, gauss,
+    // bloom, scanlines and vignette.
+    bool parse(const char* spec);
+
+    void clear() { m_passCount = 0; }
+    bool empty() const { return m_passCount == 0; }
+    int passes() const { return m_passCount; }
+
+    // Only ARGB8888 and ABGR8888 canvases are supported; other formats are
+    // left untouched and return false.
+    bool run(Canvas& canvas);
+
+private:
+    PostChain(const PostChain&);
+    PostChain& operator=(const PostChain&);
+
+    enum class Type
+    {
+        Blur,
+        Bloom,
+        Scanlines,
+        Vignette,
+    };
+
+    struct Pass
+    {
+        Type type;
+        int radius;
+        int amount; // threshold, darkening or strength, by type
+        uint16 weights[2 * cMaxRadius + 1];
+        uint16 bloomWeights[2 * cMaxRadius + 1]; // vertical weights scaled by strength
+    };
+
+    // State for one parallelFor over the row bands.
+    struct Job
+    {
+        PostChain* chain;
+        const Pass* pass;
+        const Kernels::Table* kernels;
+        uint8* pixels;
+        int pitch;
+        int width;
+        int height;
+        bool vertical;
+    };
+
+    static void runBands(void* context, int begin, int end);
+
+    Pass* addPass(Type type, int radius, int amount);
+    void horizontal(const Job& job, int band, int y0, int y1);
+    void vertical(const Job& job, int band, int y0, int y1);
+    void scanlines(const Job& job, int y0, int y1);
+    void vignette(const Job& job, int band, int y0, int y1);
+    void buildVignette(int width, int percent);
+    int vignetteFalloff(int i, int size) const;
+    uint32* bandRow(int band) { return &m_scratch[m_planeSize + band * m_bandStride]; }
+
+    int m_width;
+    int m_height;
+    JobSystem* m_jobs;
+    int m_bands;
+
+    Pass m_passes[cMaxPasses];
+    int m_passCount;
+
+    // One plane for the horizontal results, then a padded row per band.
+    std::vector<uint32> m_scratch;
+    int m_planeSize;
+    int m_bandStride;
+
+    // Per-column vignette falloff, 0..256, for the size and strength it
+    // was last built for; rows use the same curve.
+    std::vector<uint16> m_vignetteX;
+    int m_vignetteWidth;
+    int m_vignettePercent;
+};
@@ -0,0 +1,172 @@
+#include "Profile.h"
+#include "Util.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <iterator>
+
+const char* FrameProfiler::phaseName(Phase phase)
+{
+    switch (phase)
+    {
+    case Events: return "events";
+    case Clear: return "clear";
+    case Update: return "update";
+    case Render: return "render";
+    case Post: return "post";
+    case Pace: return "pace";
+    case Present: return "present";
+    default: return "unknown";
+    }
+}
+
+FrameProfiler::FrameProfiler(int capacity)
+    : m_frequency(SDL_GetPerformanceFrequency()),
+    m_runStart(0),
+    m_frameStart(0),
+    m_lastMark(0),
+    m_frames(0),
+    m_lastFrameMs(0.0),
+    m_totalMs(0.0),
+    m_samples(capacity > 0 ? capacity : 1, 0.f),
+    m_next(0)
+{
+    std::fill(std::begin(m_phaseMs), std::end(m_phaseMs), 0.0);
+    std::fill(std::begin(m_framePhaseMs), std::end(m_framePhaseMs), 0.0);
+}
+
+f64 FrameProfiler::toMs(uint64 ticks) const
+{
+    return (f64)ticks * 1000.0 / (f64)m_frequency;
+}
+
+void FrameProfiler::beginFrame()
+{
+    m_frameStart = SDL_GetPerformanceCounter();
+    m_lastMark = m_frameStart;
+    std::fill(std::begin(m_framePhaseMs), std::end(m_framePhaseMs), 0.0);
+    if (m_frames == 0)
+    {
+        m_runStart = m_frameStart;
+    }
+}
+
+void FrameProfiler::mark(Phase phase)
+{
+    uint64 now = SDL_GetPerformanceCounter();
+    f64 ms = toMs(now - m_lastMark);
+    m_phaseMs[phase] += ms;
+    m_framePhaseMs[phase] += ms;
+    m_lastMark = now;
+}
+
+void FrameProfiler::endFrame()
+{
+    uint64 now = SDL_GetPerformanceCounter();
+    m_lastFrameMs = toMs(now - m_frameStart);
+    m_totalMs = toMs(now - m_runStart);
+
+    m_samples[m_next] = (f32)m_lastFrameMs;
+    m_next = (m_next + 1) % (int)m_samples.size();
+    ++m_frames;
+}
+
+void FrameProfiler::report() const
+{
+    if (m_frames == 0)
+    {
+        return;
+    }
+
+    int count = (int)Util::Min<uint64>(m_frames, m_samples.size());
+    std::vector<f32> sorted(m_samples.begin(), m_samples.begin() + count);
+    std::sort(sorted.begin(), sorted.end());
+
+    auto percentile = [&](f64 p) { return sorted[Util::Min((int)(p * (count - 1) + 0.5), count - 1)]; };
+
+    f64 avgMs = m_totalMs / (f64)m_frames;
+    SDL_Log("benchmark: %llu frames in %.3f s, %.1f fps, %.3f ms/frame",
+        (unsigned long long)m_frames, m_totalMs / 1000.0, 1000.0 / avgMs, avgMs);
+    SDL_Log("benchmark: frame time p50 %.3f  p90 %.3f  p99 %.3f  max %.3f ms (last %d frames)",
+        percentile(0.50), percentile(0.90), percentile(0.99), sorted[count - 1], count);
+
+    for (int i = 0; i < PhaseCount; ++i)
+    {
+        f64 phaseAvg = m_phaseMs[i] / (f64)m_frames;
+        SDL_Log("benchmark:   %-8s %8.3f ms/frame %5.1f%%", phaseName((Phase)i),
+            phaseAvg, m_totalMs > 0.0 ? 100.0 * m_phaseMs[i] / m_totalMs : 0.0);
+    }
+}
+
+const char* LatencyProfiler::stageName(Stage stage)
+{
+    switch (stage)
+    {
+    case Queue: return "queue";
+    case Simulate: return "simulate";
+    case Render: return "render";
+    case Present: return "present";
+    default: return "unknown";
+    }
+}
+
+LatencyProfiler::LatencyProfiler(int capacity)
+    : m_frequency(SDL_GetPerformanceFrequency()),
+    m_inputs(0),
+    m_capacity(capacity > 0 ? capacity : 1),
+    m_next(0)
+{
+    m_samples.resize(m_capacity * (StageCount + 1), 0.f);
+}
+
+f64 LatencyProfiler::toMs(uint64 ticks) const
+{
+    return (f64)ticks * 1000.0 / (f64)m_frequency;
+}
+
+void LatencyProfiler::record(const InputStamp& stamp, uint64 presented)
+{
+    if (stamp.sampled == 0)
+    {
+        return;
+    }
+
+    f32* sample = &m_samples[m_next * (StageCount + 1)];
+    sample[Queue] = (f32)toMs(stamp.polled - stamp.sampled);
+    sample[Simulate] = (f32)toMs(stamp.updated - stamp.polled);
+    sample[Render] = (f32)toMs(stamp.rendered - stamp.updated);
+    sample[Present] = (f32)toMs(presented - stamp.rendered);
+    sample[StageCount] = (f32)toMs(presented - stamp.sampled);
+    m_next = (m_next + 1) % m_capacity;
+    ++m_inputs;
+}
+
+void LatencyProfiler::report() const
+{
+    if (m_inputs == 0)
+    {
+        return;
+    }
+
+    int count = (int)Util::Min<uint64>(m_inputs, m_capacity);
+    std::vector<f32> sorted(count);
+    auto column = [&](int index)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            sorted[i] = m_samples[i * (StageCount + 1) + index];
+        }
+        std::sort(sorted.begin(), sorted.end());
+    };
+    auto percentile = [&](f64 p) { return sorted[Util::Min((int)(p * (count - 1) + 0.5), count - 1)]; };
+
+    column(StageCount);
+    SDL_Log("benchmark: input latency p50 %.3f  p90 %.3f  p99 %.3f  max %.3f ms (last %d inputs)",
+        percentile(0.50), percentile(0.90), percentile(0.99), sorted[count - 1], count);
+
+    for (int i = 0; i < StageCount; ++i)
+    {
+        column(i);
+        SDL_Log("benchmark:   %-8s p50 %8.3f  p99 %8.3f ms", stageName((Stage)i), percentile(0.50), percentile(0.99));
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Types.h"
+#include "InputStamp.h"
+
+#include <vector>
+
+// Collects per-frame timings for the benchmark report: total frame time for
+// percentiles plus accumulated time per phase of the frame loop.
+class FrameProfiler
+{
+public:
+    enum Phase
+    {
+        Events,
+        Clear,
+        Update,
+        Render,
+        Post,
+        Pace,
+        Present,
+        PhaseCount,
+    };
+
+    static const char* phaseName(Phase phase);
+
+    // capacity bounds how many frame times are kept for percentiles; older
+    // samples are overwritten once it is exceeded.
+    explicit FrameProfiler(int capacity);
+
+    void beginFrame();
+    // Attributes the time since the previous mark (or beginFrame) to phase.
+    void mark(Phase phase);
+    void endFrame();
+
+    uint64 frames() const { return m_frames; }
+    f64 lastFrameMs() const { return m_lastFrameMs; }
+    f64 lastPhaseMs(Phase phase) const { return m_framePhaseMs[phase]; }
+
+    void report() const;
+
+private:
+    f64 toMs(uint64 ticks) const;
+
+    uint64 m_frequency;
+    uint64 m_runStart;
+    uint64 m_frameStart;
+    uint64 m_lastMark;
+
+    uint64 m_frames;
+    f64 m_lastFrameMs;
+    f64 m_totalMs;
+    f64 m_phaseMs[PhaseCount];
+    f64 m_framePhaseMs[PhaseCount];
+
+    std::vector<f32> m_samples;
+    int m_next;
+};
+
+// Input-to-photon latency: for every frame that is the first to show an
+// input change, the time from sampling the event to the frame's present
+// returning, split by stage.
+class LatencyProfiler
+{
+public:
+    enum Stage
+    {
+        Queue,
+        Simulate,
+        Render,
+        Present,
+        StageCount,
+    };
+
+    static const char* stageName(Stage stage);
+
+    // capacity bounds how many latencies are kept; older ones are overwritten.
+    explicit LatencyProfiler(int capacity);
+
+    // Frames whose stamp has no input are ignored. Called from whichever
+    // thread presents, one at a time.
+    void record(const InputStamp& stamp, uint64 presented);
+
+    uint64 inputs() const { return m_inputs; }
+
+    void report() const;
+
+private:
+    f64 toMs(uint64 ticks) const;
+
+    uint64 m_frequency;
+    uint64 m_inputs;
+    std::vector<f32> m_samples; // StageCount + 1 per input: the stages, then the total
+    int m_capacity;
+    int m_next;
+};
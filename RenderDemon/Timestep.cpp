@@ -0,0 +1,49 @@
+#include "Timestep.h"
+
+#include <SDL2/SDL.h>
+
+FixedTimestep::FixedTimestep(f64 rate, int maxSteps)
+    : m_rate(rate > 0.0 ? rate : 0.0),
+    m_maxSteps(maxSteps > 0 ? maxSteps : 1),
+    m_stepTicks(0),
+    m_last(0),
+    m_accumulator(0),
+    m_alpha(1.f),
+    m_steps(0),
+    m_dropped(0)
+{
+    if (m_rate > 0.0)
+    {
+        m_stepTicks = (uint64)((f64)SDL_GetPerformanceFrequency() / m_rate);
+        m_stepTicks = m_stepTicks > 0 ? m_stepTicks : 1;
+    }
+}
+
+int FixedTimestep::advance()
+{
+    if (m_stepTicks == 0)
+    {
+        ++m_steps;
+        return 1;
+    }
+
+    const uint64 now = SDL_GetPerformanceCounter();
+    int steps;
+    if (m_steps == 0)
+    {
+        steps = 1;
+    }
+    else
+    {
+        // Counted in ticks, not seconds, so the accumulator never drifts.
+        m_accumulator += now - m_last;
+        const uint64 due = m_accumulator / m_stepTicks;
+        m_accumulator -= due * m_stepTicks;
+        steps = (int)(due < (uint64)m_maxSteps ? due : m_maxSteps);
+        m_dropped += due - steps;
+    }
+    m_last = now;
+    m_steps += steps;
+    m_alpha = (f32)((f64)m_accumulator / (f64)m_stepTicks);
+    return steps;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Types.h"
+
+// Decides how many fixed simulation steps each rendered frame runs. Real
+// time since the last frame goes into an accumulator and every whole step
+// in it is run, up to maxSteps; beyond that the backlog is dropped so a
+// long stall slows the game down instead of freezing it while it catches
+// up. What is left over is how far rendering should blend from the
+// previous step's state towards the latest one.
+class FixedTimestep
+{
+public:
+    // rate is in steps per second; 0 runs exactly one step per frame.
+    FixedTimestep(f64 rate, int maxSteps);
+
+    // Adds the time since the previous call and returns the steps to run
+    // now. The first call always runs one.
+    int advance();
+
+    // The leftover as a fraction of a step, 0 to 1. Always 1 with rate 0.
+    f32 alpha() const { return m_alpha; }
+
+    f64 rate() const { return m_rate; }
+    uint64 steps() const { return m_steps; }
+    uint64 dropped() const { return m_dropped; }
+
+private:
+    f64 m_rate;
+    int m_maxSteps;
+    uint64 m_stepTicks; // performance counter ticks per step
+    uint64 m_last;
+    uint64 m_accumulator;
+    f32 m_alpha;
+    uint64 m_steps;
+    uint64 m_dropped; // whole steps thrown away by the cap
+};
@@ -17,6 +17,14 @@ typedef unsigned int uint;
 typedef float f32;
 typedef double f64;
 
+// Per-thread storage. VS2013 has no thread_local; __declspec(thread) works
+// for the constant-initialized globals this is used for.
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL thread_local
+#endif
+
 struct Point
 {
     Point() : x(0), y(0) {}
@@ -24,6 +24,12 @@ namespace Util
         return (a >= b) ? a : b;
     }
 
+    template <typename T>
+    inline T Clamp(T v, T lo, T hi)
+    {
+        return Min(Max(v, lo), hi);
+    }
+
     template <typename T>
     inline T Min3(T a, T b, T c)
     {
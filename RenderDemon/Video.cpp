@@ -1,383 +1,255 @@
 #include "Video.h"
-#include "Util.h"
-#include <cmath>
-#include <new>
-#include <cassert>
-
-Video::Video(int width, int height, SDL_Renderer* renderer)
-    : m_width(width),
-    m_height(height),
-    m_renderer(renderer)
-{
-    m_surface = SDL_CreateRGBSurface(0, width, height, 32,
-        0x000000FF,
-        0x0000FF00,
-        0x00FF0000,
-        0x00000000);
-
-    const int cDefaultColorPaletteCount = 16;
-    m_defaultColorPalette = new SDL_Color[cDefaultColorPaletteCount];
-
-    m_defaultColorPalette[0x0] = { 128, 128, 128, 255 };
-    m_defaultColorPalette[0x1] = { 0, 0, 255, 255 };
-    m_defaultColorPalette[0x2] = { 0, 255, 0, 255 };
-    m_defaultColorPalette[0x3] = { 0, 255, 255, 255 };
-
-    m_defaultColorPalette[0x4] = { 255, 0, 0, 255 };
-    m_defaultColorPalette[0x5] = { 255, 0, 255, 255 };
-    m_defaultColorPalette[0x6] = { 255, 255, 0, 255 };
-    m_defaultColorPalette[0x7] = { 255, 255, 255, 255 };
-
-    m_defaultColorPalette[0x8] = { 128, 128, 128, 255 };
-    m_defaultColorPalette[0x9] = { 0, 0, 255, 255 };
-    m_defaultColorPalette[0xA] = { 0, 255, 0, 255 };
-    m_defaultColorPalette[0xB] = { 0, 255, 255, 255 };
-
-    m_defaultColorPalette[0xC] = { 255, 0, 0, 255 };
-    m_defaultColorPalette[0xD] = { 255, 0, 255, 255 };
-    m_defaultColorPalette[0xE] = { 255, 255, 0, 255 };
-    m_defaultColorPalette[0xF] = { 255, 255, 255, 255 };
+#include "Memory.h"
+#include "Capture.h"
+
+#include <cstring>
+
+Video::Video(int width, int height, SDL_Window* window, PixelFormat format, int scale, Uint32 rendererFlags)
+    : Canvas(width, height, format),
+    m_window(window),
+    m_rendererFlags(rendererFlags),
+    m_renderer(nullptr),
+    m_scale(scale > 0 ? scale : 1),
+    m_texture(nullptr),
+    m_presentRow(nullptr),
+    m_grade(nullptr),
+    m_latency(nullptr),
+    m_queueDepth(0),
+    m_submitted(0),
+    m_uploaded(0),
+    m_quit(false)
+{
+    Memory::Scope memoryScope(Memory::Tag::Video);
+
+    if (m_window)
+    {
+        createRenderer();
+        if (m_scale > 1)
+        {
+            m_presentRow = new uint32[width];
+        }
+    }
 
-    setColorPalette(m_defaultColorPalette, cDefaultColorPaletteCount);
+    memset(m_slots, 0, sizeof(m_slots));
 }
 
 Video::~Video()
 {
-    SDL_FreeSurface(m_surface);
-    delete m_defaultColorPalette;
-}
-
-void Video::setColorPalette(SDL_Color* palette, int count)
-{
-    m_colorPalette = palette;
-    m_colorPaletteCount = count;
-}
-
-void Video::setDrawColor(uint8 r, uint8 g, uint8 b)
-{
-    m_drawColor.r = r;
-    m_drawColor.g = g;
-    m_drawColor.b = b;
-}
-
-void Video::setDrawColor(int index)
-{
-    assert(index >= 0 && index < m_colorPaletteCount);
-    m_drawColor = m_colorPalette[index];
-}
-
-void Video::setClearColor(uint8 r, uint8 g, uint8 b)
-{
-    m_clearColor.r = r;
-    m_clearColor.g = g;
-    m_clearColor.b = b;
-}
-
-void Video::setClearColor(int index)
-{
-    assert(index >= 0 && index < m_colorPaletteCount);
-    m_clearColor = m_colorPalette[index];
-}
-
-void Video::clear()
-{
-    SDL_SetRenderDrawColor(m_renderer, m_clearColor.r, m_clearColor.g, m_clearColor.b, 255);
-    SDL_RenderClear(m_renderer);
-
-    setDrawColor(m_clearColor.r, m_clearColor.g, m_clearColor.b);
-    resetView();
-    fillRect(0, 0, m_width, m_height);
-    setDrawColor(m_drawColor.r, m_drawColor.g, m_drawColor.b);
-}
-
-void Video::present()
-{
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(m_renderer, m_surface);
-    SDL_SetRenderDrawColor(m_renderer, 255, 255, 255, 255);
-    SDL_RenderCopy(m_renderer, texture, nullptr, nullptr);
-    SDL_DestroyTexture(texture);
-    SDL_RenderPresent(m_renderer);
-}
-
-uint32* Video::getPixel(int x, int y)
-{
-    if (x < 0 || x >= m_width || y < 0 || y >= m_height)
+    if (m_queueDepth > 0)
     {
-        return nullptr;
+        stopPresentThread();
     }
-
-    int bpp = m_surface->format->BytesPerPixel;
-    return (uint32*)((uint8*)m_surface->pixels + y * m_surface->pitch + x * bpp);
-}
-
-void Video::setPixel(uint32* p)
-{
-    *p = m_drawColor.r + (m_drawColor.g << 8) + (m_drawColor.b << 16);
-}
-
-SDL_Color Video::getPixelColor(int x, int y)
-{
-    uint32* p = getPixel(x, y);
-    if (!p)
+    else
     {
-        const SDL_Color cBlack = { 0, 0, 0, 255 };
-        return cBlack;
+        destroyRenderer();
     }
-
-    SDL_Color color = {
-        *((uint8*)p + 3),
-        *((uint8*)p + 2),
-        *((uint8*)p + 1),
-        *((uint8*)p + 0),
-    };
-
-    return color;
+    delete[] m_presentRow;
 }
 
-void Video::pointc(int x, int y, int count)
+void Video::createRenderer()
 {
-    uint32* p = getPixel(x + m_viewOffsetX, y + m_viewOffsetY);
-    if (!p) { return; }
-
-    if (x < 0 || x > m_viewWidth || y < 0 || y > m_viewHeight)
+    m_renderer = SDL_CreateRenderer(m_window, -1, m_rendererFlags);
+    if (!m_renderer)
     {
+        SDL_Log("video: could not create a renderer: %s", SDL_GetError());
         return;
     }
 
-    int pos = y * m_surface->w + x;
-    int c = count;
-    if (pos + c >= m_surface->w * m_surface->h)
-    {
-        c = (m_surface->w * m_surface->h) - pos;
-    }
-    for (int i = 0; i < c; ++i)
-    {
-        setPixel(p++);
-    }
+    // The texture is created once and streamed into every frame so present()
+    // never allocates. Each format uploads into a texture format the common
+    // renderers take natively, so SDL does no conversion of its own. It is
+    // window sized, so the renderer never scales either.
+    m_texture = SDL_CreateTexture(m_renderer, textureFormat(),
+        SDL_TEXTUREACCESS_STREAMING, width() * m_scale, height() * m_scale);
 }
 
-void Video::point(int x, int y)
+void Video::destroyRenderer()
 {
-    uint32* p = getPixel(x + m_viewOffsetX, y + m_viewOffsetY);
-    if (p)
+    if (m_texture)
     {
-        if (x < 0 || x > m_viewWidth || y < 0 || y > m_viewHeight)
-        {
-            return;
-        }
-        setPixel(p);
+        SDL_DestroyTexture(m_texture);
+        m_texture = nullptr;
     }
-}
-
-void Video::points(int* data, int count)
-{
-    for (int i = 0; i < count; ++i)
+    if (m_renderer)
     {
-        point(data[i * 2 + 0], data[i * 2 + 1]);
+        SDL_DestroyRenderer(m_renderer);
+        m_renderer = nullptr;
     }
 }
 
-void Video::vline(int x, int y1, int y2)
+void Video::setPresentQueue(int depth)
 {
-    if (y1 > y2) { Util::Swap(y1, y2); }
-    for (int y = y1; y <= y2; ++y)
+    depth = depth < 0 ? 0 : (depth > cMaxPresentQueue ? cMaxPresentQueue : depth);
+    if (!m_window || depth == m_queueDepth)
     {
-        point(x, y);
+        return;
     }
-}
 
-void Video::hline(int y, int x1, int x2)
-{
-    if (x1 > x2) { Util::Swap(x1, x2); }
-    int right = x2;
-    if (right > m_width) { right = m_width; }
-    pointc(x1, y, (right - x1));
-}
-
-void Video::line(int x1, int y1, int x2, int y2)
-{
-    int dx = abs(x2 - x1);
-    int dy = abs(y2 - y1);
-
-    if (dx == 0)
+    // The renderer always belongs to the thread that presents: a running
+    // present thread destroys its own on the way out, otherwise this
+    // thread's is given up before the present thread makes a new one.
+    if (m_queueDepth > 0)
     {
-        vline(x1, y1, y2);
-        return;
+        stopPresentThread();
     }
-    else if (dy == 0)
+    else
     {
-        hline(y1, x1, x2);
+        destroyRenderer();
+    }
+    if (depth == 0)
+    {
+        createRenderer();
         return;
     }
 
-    int sx = (x1 < x2) ? 1 : -1;
-    int sy = (y1 < y2) ? 1 : -1;
-    int err = (dx > dy ? dx : -dy) / 2, e2;
+    Memory::Scope memoryScope(Memory::Tag::Video);
 
-    while (true)
+    m_slots[0].surface = swapSurface(nullptr);
+    for (int i = 1; i <= depth; ++i)
     {
-        point(x1, y1);
-        if (x1 == x2 && y1 == y2) break;
-        e2 = err;
-        if (e2 > -dx) { err -= dy; x1 += sx; }
-        if (e2 < dy) { err += dx; y1 += sy; }
+        m_slots[i].surface = createSurface();
     }
+    swapSurface(m_slots[0].surface);
+
+    m_queueDepth = depth;
+    m_submitted = 0;
+    m_uploaded = 0;
+    m_quit = false;
+    m_presentThread = std::thread(&Video::presentMain, this);
 }
 
-void Video::lines(int* data, int segments)
+void Video::stopPresentThread()
 {
-    for (int i = 0; i < segments; ++i)
+    if (m_queueDepth == 0)
     {
-        line(data[(i * 2) + 0], data[(i * 2) + 1],
-             data[((i + 1) * 2) + 0], data[((i + 1) * 2) + 1]);
+        return;
     }
-}
 
-void Video::rect(int x1, int y1, int x2, int y2)
-{
-    line(x1, y1, x2, y1);
-    line(x2, y1, x2, y2);
-    line(x1, y1, x1, y2);
-    line(x1, y2, x2, y2);
-}
+    // Queued frames are still shown before the thread leaves.
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_queued.notify_one();
+    m_presentThread.join();
 
-void Video::fillRect(int x1, int y1, int x2, int y2)
-{
-    for (int y = y1; y <= y2; ++y)
+    // The canvas goes back to its own surface; the rest of the ring is freed.
+    swapSurface(m_slots[0].surface);
+    for (int i = 1; i <= m_queueDepth; ++i)
     {
-        hline(y, x1, x2);
+        SDL_FreeSurface(m_slots[i].surface);
+        m_slots[i].surface = nullptr;
     }
+    m_queueDepth = 0;
 }
 
-void Video::triangle(int x1, int y1, int x2, int y2, int x3, int y3)
+void Video::present(const InputStamp* stamp)
 {
-    Point points[3] = {
-        { x1, y1 },
-        { x2, y2 },
-        { x3, y3 },
-    };
+    CaptureScope capture(this);
+    if (DrawCapture* c = capture.get()) { c->endFrame(); }
 
-    Util::ArraySort<Point>(points, 3, [](const Point* p1, const Point* p2){ return p1->y < p2->y; });
+    endInterlacedFrame();
 
-    if (points[1].y == points[2].y)
-    {
-        triangleFlatBottom(points);
-    }
-    else if (points[0].y == points[1].y)
+    if (m_queueDepth == 0)
     {
-        triangleFlatTop(points);
+        if (m_renderer)
+        {
+            uploadFrame(frameSource());
+            showFrame(renderWidth(), renderHeight());
+        }
+        if (stamp && m_latency)
+        {
+            m_latency->record(*stamp, SDL_GetPerformanceCounter());
+        }
+        return;
     }
-    else
-    {
-        int x4 = points[0].x + (int)roundf((f32)(points[1].y - points[0].y) / (f32)(points[2].y - points[0].y) * (f32)(points[2].x - points[0].x));
-        int y4 = points[1].y;
 
-        Point top[3] = {
-            points[0],
-            points[1],
-            { x4, y4 },
-        };
-
-        Point bottom[3] = {
-            points[1],
-            { x4, y4 },
-            points[2],
-        };
-
-        triangleFlatBottom(top);
-        triangleFlatTop(bottom);
+    // The palette may change before the present thread gets to this frame,
+    // so the slot keeps the one it was drawn with.
+    const int buffers = m_queueDepth + 1;
+    Slot& slot = m_slots[m_submitted % buffers];
+    slot.source = frameSource();
+    slot.stamp = stamp ? *stamp : InputStamp();
+    if (format() == PixelFormat::Indexed8)
+    {
+        memcpy(slot.palette, slot.source.palette, sizeof(slot.palette));
+        slot.source.palette = slot.palette;
     }
-}
-
-void Video::triangleFlatBottom(Point* points)
-{
-    int topx = points[0].x;
-    int topy = points[0].y;
-    int y = points[1].y;
-    int leftx = points[1].x;
-    int rightx = points[2].x;
-
-    f32 mleft = (f32)(leftx - topx) / (f32)(y - topy);
-    f32 mright = (f32)(rightx - topx) / (f32)(y - topy);
 
-    f32 left = (f32)topx;
-    f32 right = (f32)topx;
-
-    for (int i = topy; i <= y; ++i)
+    // The next surface is free once the frame drawn into it a full ring ago
+    // has been uploaded.
+    uint64 next;
     {
-        hline(i, (int)left, (int)right);
-        left += mleft;
-        right += mright;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        next = ++m_submitted;
+        m_queued.notify_one();
+        m_freed.wait(lock, [this, next, buffers] { return m_uploaded + buffers > next; });
     }
+    swapSurface(m_slots[next % buffers].surface);
 }
 
-void Video::triangleFlatTop(Point* points)
+void Video::uploadFrame(const FrameSource& source)
 {
-    int botx = points[2].x;
-    int boty = points[2].y;
-    int y = points[0].y;
-    int leftx = points[0].x;
-    int rightx = points[1].x;
-
-    f32 mleft = (f32)(botx - leftx) / (f32)(boty - y);
-    f32 mright = (f32)(botx - rightx) / (f32)(boty - y);
-
-    f32 left = (f32)botx;
-    f32 right = (f32)botx;
-
-    for (int i = boty; i > y; --i)
+    void* pixels;
+    int pitch;
+    if (m_texture && SDL_LockTexture(m_texture, nullptr, &pixels, &pitch) == 0)
     {
-        hline(i, (int)roundf(left), (int)roundf(right));
-        left -= mleft;
-        right -= mright;
+        upload(source, pixels, pitch, m_scale, m_presentRow, m_grade && m_grade->mode() != ColorGrade::Mode::None ? m_grade : nullptr);
+        SDL_UnlockTexture(m_texture);
     }
 }
 
-void Video::quad(int x1, int y1, int x2, int y2, int x3, int y3, int x4, int y4)
+void Video::showFrame(int width, int height)
 {
-    triangle(x1, y1, x2, y2, x4, y4);
-    triangle(x2, y2, x3, y3, x4, y4);
-}
-
-void Video::resetView()
-{
-    m_viewOffsetX = 0;
-    m_viewOffsetY = 0;
-    m_viewWidth = m_width;
-    m_viewHeight = m_height;
-}
-
-void Video::view(int x1, int y1, int x2, int y2)
-{
-    m_viewOffsetX = x1;
-    m_viewOffsetY = y1;
-    m_viewWidth = x2 - x1;
-    m_viewHeight = y2 - y1;
-
-    int nx1 = x1 - m_viewOffsetX, nx2 = x2 - m_viewOffsetX;
-    int ny1 = y1 - m_viewOffsetY, ny2 = y2 - m_viewOffsetY;
-
-    line(nx1, ny1, nx2, ny1);
-    line(nx2, ny1, nx2, ny2);
-    line(nx1, ny1, nx1, ny2);
-    line(nx1, ny2, nx2, ny2);
+    // Only the rendered part of the texture was written; the renderer
+    // stretches it over the window when the render scale is below 100%.
+    SDL_Rect source = { 0, 0, width * m_scale, height * m_scale };
+    SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 255);
+    SDL_RenderClear(m_renderer);
+    SDL_RenderCopy(m_renderer, m_texture, &source, nullptr);
+    SDL_RenderPresent(m_renderer);
 }
 
-void Video::test()
+void Video::presentMain()
 {
-    /*setDrawColor(255, 0, 0);
-    line(0, 0, 200, 200);*/
+    createRenderer();
 
-    setDrawColor(0, 255, 0);
-    point(100, 10);
-    rect(5, 5, 25, 35);
+    const int buffers = m_queueDepth + 1;
+    for (;;)
+    {
+        uint64 frame;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_queued.wait(lock, [this] { return m_uploaded < m_submitted || m_quit; });
+            if (m_uploaded == m_submitted)
+            {
+                break;
+            }
+            frame = m_uploaded;
+        }
 
-    setDrawColor(255, 0, 255);
-    quad(5, 50, 30, 55, 70, 90, 10, 105);
+        // The surface is released as soon as the texture holds it, before
+        // presenting, which is where a vsync wait would block.
+        const FrameSource& source = m_slots[frame % buffers].source;
+        const int width = source.width;
+        const int height = source.height;
+        const InputStamp stamp = m_slots[frame % buffers].stamp;
+        uploadFrame(source);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_uploaded;
+        }
+        m_freed.notify_one();
 
-    setDrawColor(255, 255, 0);
-    line(80, 100, 120, 70);
+        if (m_renderer)
+        {
+            showFrame(width, height);
+        }
+        if (m_latency)
+        {
+            m_latency->record(stamp, SDL_GetPerformanceCounter());
+        }
+    }
 
-    setDrawColor(0, 255, 255);
-    triangle(50, 5, 30, 20, 100, 80);
-}
\ No newline at end of file
+    destroyRenderer();
+}
@@ -1,73 +1,91 @@
 #pragma once
 
-#include "Types.h"
+#include "Canvas.h"
+#include "ColorGrade.h"
+#include "Profile.h"
 
-#include <SDL2/SDL.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
-class Video
+// The canvas that is shown: owns the renderer and streaming texture and
+// presents into the window. SDL only allows render calls on the thread
+// that created the renderer, so both are created by whichever thread
+// presents: the one that constructs the canvas, or the present thread.
+class Video : public Canvas
 {
 public:
-    Video(int width, int height, SDL_Renderer* renderer);
-    ~Video();
-
-    void setColorPalette(SDL_Color* palette, int count);
+    static const int cMaxPresentQueue = 2;
 
-    void setDrawColor(uint8 r, uint8 g, uint8 b);
-    void setDrawColor(int index);
-    void setClearColor(uint8 r, uint8 g, uint8 b);
-    void setClearColor(int index);
+    // window may be null for headless use; present() then only ends the frame.
+    // width and height are the internal resolution everything is drawn at;
+    // present() upscales it by the integer scale into the window-sized texture.
+    // The window is not owned and must outlive the canvas.
+    Video(int width, int height, SDL_Window* window, PixelFormat format = PixelFormat::ABGR8888, int scale = 1,
+        Uint32 rendererFlags = SDL_RENDERER_ACCELERATED);
+    ~Video();
 
-    void clear();
-    void present();
+    int scale() const { return m_scale; }
 
-    void pointc(int x, int y, int count);
+    // Applied while uploading in present(); null (the default) uploads as is.
+    // The grade is not owned and must outlive its use here.
+    void setColorGrade(const ColorGrade* grade) { m_grade = grade; }
 
-    void point(int x, int y);
-    void points(int* data, int count); // count is number of points so expects count * 2 ints
-    void vline(int x, int y1, int y2);
-    void hline(int y, int x1, int x2);
-    void line(int x1, int y1, int x2, int y2);
-    void lines(int* data, int segments);
-    void rect(int x1, int y1, int x2, int y2);
-    void fillRect(int x1, int y1, int x2, int y2);
-    void triangle(int x1, int y1, int x2, int y2, int x3, int y3);
-    void quad(int x1, int y1, int x2, int y2, int x3, int y3, int x4, int y4);
+    // How many finished frames may wait for the present thread. 0 (the
+    // default) uploads and presents on the calling thread. 1 or 2 start a
+    // present thread, which recreates the renderer and texture as its own
+    // and does all uploading and presenting; the canvas draws into a ring of
+    // depth + 1 surfaces, so present() returns as soon as the next surface is
+    // free and drawing goes on while the last frame is uploaded. Going back
+    // to 0 recreates them on the calling thread.
+    // Surfaces are handed over, never copied, so a new frame starts on
+    // whatever its surface held depth + 1 frames ago: clear every frame, and
+    // do not combine with interlacing. Headless canvases ignore the setting.
+    void setPresentQueue(int depth);
+    int presentQueue() const { return m_queueDepth; }
 
-    void resetView();
-    void view(int x1, int y1, int x2, int y2);
+    // Input-to-photon latency is recorded into this for every stamped
+    // frame once it has been shown. Not owned; null (the default) records
+    // nothing.
+    void setLatencyProfiler(LatencyProfiler* latency) { m_latency = latency; }
 
-    void test();
+    // stamp, if given, is the input the frame reflects.
+    void present(const InputStamp* stamp = nullptr);
 
 private:
-    uint32* getPixel(int x, int y);
-    void setPixel(uint32* p);
-    SDL_Color getPixelColor(int x, int y);
-    
-    // drawing helpers
-    void triangleFlatBottom(Point* points);
-    void triangleFlatTop(Point* points);
+    // One surface of the ring and the state its frame was drawn with.
+    struct Slot
+    {
+        SDL_Surface* surface;
+        FrameSource source;
+        InputStamp stamp;
+        uint32 palette[256];
+    };
 
-private:
-    int m_width;
-    int m_height;
-    SDL_Renderer* m_renderer;
-    SDL_Surface* m_surface;
-    SDL_Color m_drawColor;
-    SDL_Color m_clearColor;
+    // On the presenting thread only.
+    void createRenderer();
+    void destroyRenderer();
+    void uploadFrame(const FrameSource& source);
+    void showFrame(int width, int height);
+    void presentMain();
+    void stopPresentThread();
 
-    SDL_Color* m_defaultColorPalette;
-    SDL_Color* m_colorPalette;
-    int m_colorPaletteCount;
+    SDL_Window* m_window;
+    Uint32 m_rendererFlags;
+    SDL_Renderer* m_renderer;
+    int m_scale;
+    SDL_Texture* m_texture;
+    uint32* m_presentRow; // one converted row when upscaling
+    const ColorGrade* m_grade;
+    LatencyProfiler* m_latency;
 
-    int m_viewOffsetX;
-    int m_viewOffsetY;
-    int m_viewWidth;
-    int m_viewHeight;
+    int m_queueDepth;
+    Slot m_slots[cMaxPresentQueue + 1]; // the first holds the canvas's own surface
+    std::thread m_presentThread;
+    std::mutex m_mutex;
+    std::condition_variable m_queued; // signalled to the present thread
+    std::condition_variable m_freed; // signalled to the drawing thread
+    uint64 m_submitted; // frames handed to the present thread, guarded by m_mutex
+    uint64 m_uploaded; // frames whose surface is free again, guarded by m_mutex
+    bool m_quit;
 };
-
-inline bool rgbEqual(const SDL_Color& c1, const SDL_Color& c2)
-{
-    return c1.r == c2.r &&
-        c1.g == c2.g &&
-        c1.b == c2.b;
-}
\ No newline at end of file
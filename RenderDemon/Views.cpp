@@ -0,0 +1,138 @@
+#include "Views.h"
+#include "Jobs.h"
+#include "Memory.h"
+
+#include <cassert>
+
+ViewBatch::ViewBatch(Canvas& target, int maxViews)
+    : m_target(target),
+    m_count(0)
+{
+    Memory::Scope memoryScope(Memory::Tag::Video);
+
+    m_views.resize(maxViews);
+    for (View& view : m_views)
+    {
+        view.canvas = new Canvas(&target);
+    }
+}
+
+ViewBatch::~ViewBatch()
+{
+    for (View& view : m_views)
+    {
+        delete view.canvas;
+    }
+}
+
+void ViewBatch::add(int x1, int y1, int x2, int y2, ViewFunction fn, void* context)
+{
+    View& view = next(x1, y1, x2, y2, context);
+    view.fn = fn;
+}
+
+void ViewBatch::addStrips(int x1, int y1, int x2, int y2, int strips, StripFunction fn, void* context)
+{
+    const int width = x2 - x1 + 1;
+    strips = strips < 1 ? 1 : strips > width ? width : strips;
+    for (int i = 0; i < strips; ++i)
+    {
+        View& view = next(x1, y1, x2, y2, context);
+        view.first = width * i / strips;
+        view.last = width * (i + 1) / strips - 1;
+        view.strip = fn;
+    }
+}
+
+ViewBatch::View& ViewBatch::next(int x1, int y1, int x2, int y2, void* context)
+{
+    assert(m_count < (int)m_views.size());
+
+    View& view = m_views[m_count++];
+    view.x1 = x1;
+    view.y1 = y1;
+    view.x2 = x2;
+    view.y2 = y2;
+    view.first = 0;
+    view.last = x2 - x1;
+    view.fn = nullptr;
+    view.strip = nullptr;
+    view.context = context;
+    return view;
+}
+
+void ViewBatch::run(JobSystem* jobs)
+{
+    if (m_target.m_capture)
+    {
+        for (int i = 0; i < m_count; ++i)
+        {
+            const View& view = m_views[i];
+            m_target.pushView(view.x1, view.y1, view.x2, view.y2);
+            if (view.strip)
+            {
+                m_target.pushScissor(view.first, 0, view.last, view.y2 - view.y1);
+            }
+            draw(view, m_target);
+            if (view.strip)
+            {
+                m_target.popScissor();
+            }
+            m_target.popView();
+        }
+        m_count = 0;
+        return;
+    }
+
+    for (int i = 0; i < m_count; ++i)
+    {
+        const View& view = m_views[i];
+        Canvas& canvas = *view.canvas;
+        canvas.shareFrom(m_target);
+        canvas.pushView(view.x1, view.y1, view.x2, view.y2);
+        if (view.strip)
+        {
+            canvas.pushScissor(view.first, 0, view.last, view.y2 - view.y1);
+        }
+
+#ifndef NDEBUG
+        for (int j = 0; j < i; ++j)
+        {
+            const Canvas::ClipRect& a = canvas.m_clip;
+            const Canvas::ClipRect& b = m_views[j].canvas->m_clip;
+            assert(a.left >= b.right || b.left >= a.right || a.top >= b.bottom || b.top >= a.bottom);
+        }
+#endif
+    }
+
+    if (jobs)
+    {
+        jobs->parallelFor(m_count, 1, runViews, this);
+    }
+    else
+    {
+        runViews(this, 0, m_count);
+    }
+    m_count = 0;
+}
+
+void ViewBatch::runViews(void* context, int begin, int end)
+{
+    ViewBatch* batch = (ViewBatch*)context;
+    for (int i = begin; i < end; ++i)
+    {
+        draw(batch->m_views[i], *batch->m_views[i].canvas);
+    }
+}
+
+void ViewBatch::draw(const View& view, Canvas& canvas)
+{
+    if (view.strip)
+    {
+        view.strip(view.context, canvas, view.first, view.last);
+    }
+    else
+    {
+        view.fn(view.context, canvas);
+    }
+}
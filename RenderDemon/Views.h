@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Canvas.h"
+
+#include <vector>
+
+class JobSystem;
+
+// Independent panels of one canvas, drawn concurrently. Each view gets its
+// own child canvas, scissored and translated to its rect as by pushView(),
+// that writes straight into the target's surface. Views never share pixels,
+// so nothing is locked; rects that overlap are a caller error.
+//
+// Children are allocated up front, one per view slot. At run() they pick up
+// the target's current state (palette, draw color, dither, scissor and
+// transform) and draw with it; changes they make are not seen by the target.
+class ViewBatch
+{
+public:
+    typedef void (*ViewFunction)(void* context, Canvas& view);
+    // first and last are the strip's columns in the panel's coordinates.
+    typedef void (*StripFunction)(void* context, Canvas& view, int first, int last);
+
+    ViewBatch(Canvas& target, int maxViews);
+    ~ViewBatch();
+
+    // Queues fn(context, view) for the inclusive rect x1..x2, y1..y2 in the
+    // target's current coordinates.
+    void add(int x1, int y1, int x2, int y2, ViewFunction fn, void* context);
+
+    // Splits a panel into up to strips vertical strips, each its own view.
+    // Every strip sees the whole panel's coordinates, as add() would give,
+    // but is scissored to its own columns. Drawing that is exact under a
+    // scissor (lines, spans, columns) comes out the same for any count.
+    void addStrips(int x1, int y1, int x2, int y2, int strips, StripFunction fn, void* context);
+
+    // Draws every queued view and empties the batch. Views run as jobs on
+    // jobs, or in order on the calling thread if it is null. A target that
+    // is capturing draws them itself, in order, so the capture replays
+    // exactly.
+    void run(JobSystem* jobs);
+
+private:
+    ViewBatch(const ViewBatch&);
+    ViewBatch& operator=(const ViewBatch&);
+
+    struct View
+    {
+        int x1, y1, x2, y2;
+        int first, last; // strips only, in panel coordinates
+        ViewFunction fn;
+        StripFunction strip;
+        void* context;
+        Canvas* canvas;
+    };
+
+    View& next(int x1, int y1, int x2, int y2, void* context);
+    static void runViews(void* context, int begin, int end);
+    static void draw(const View& view, Canvas& canvas);
+
+    Canvas& m_target;
+    std::vector<View> m_views;
+    int m_count;
+};
@@ -1,12 +1,26 @@
-#define _CRTDBG_MAP_ALLOC
-#include <stdlib.h>
-#include <crtdbg.h>
-
 #include <SDL2/SDL.h>
 #include "Video.h"
 #include "Input.h"
+#include "InputQueue.h"
+#include "InputRecord.h"
+#include "Profile.h"
+#include "Memory.h"
+#include "Capture.h"
+#include "DynamicResolution.h"
+#include "PostProcess.h"
+#include "Jobs.h"
+#include "FramePipeline.h"
+#include "Views.h"
+#include "Timestep.h"
+#include "Pacing.h"
+#include "Palette.h"
+#include "Util.h"
 
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 
 struct Vec2
 {
@@ -37,6 +51,8 @@ struct TestRenderer
 {
     void update(const InputManager& input)
     {
+        stamp = input.stamp();
+
         if (input.getKey(SDL_SCANCODE_LEFT))
         {
             angle -= 0.1f;
@@ -72,74 +88,125 @@ struct TestRenderer
         }
     }
 
-    void render(Video* ctx)
+    // The three panels are independent, so they are drawn as a batch of
+    // views, the 3D one split into column strips; only the borders go
+    // straight to the canvas.
+    void render(Video* ctx, ViewBatch& views, int strips, JobSystem* jobs)
     {
         ctx->setDrawColor(1);
-        ctx->view(4, 40, 103, 149);
-
-        ctx->setDrawColor(14);
-        ctx->line(vx1, vy1, vx2, vy2);
-        ctx->setDrawColor(8);
-        ctx->line(px, py, cosf(angle) * 5.f + px, sinf(angle) * 5.f + py);
-        ctx->setDrawColor(15);
-        ctx->point(px, py);
-
+        ctx->rect(4, 40, 103, 149);
         ctx->setDrawColor(2);
-        ctx->view(109, 40, 208, 149);
+        ctx->rect(109, 40, 208, 149);
+        ctx->setDrawColor(3);
+        ctx->rect(214, 40, 315, 149);
 
-        f32 tx1 = vx1 - px, ty1 = vy1 - py;
-        f32 tx2 = vx2 - px, ty2 = vy2 - py;
-        f32 tz1 = tx1 * cosf(angle) + ty1 * sinf(angle);
-        f32 tz2 = tx2 * cosf(angle) + ty2 * sinf(angle);
+        views.add(4, 40, 103, 149, renderMap, this);
+        views.add(109, 40, 208, 149, renderLocal, this);
+        views.addStrips(214, 40, 315, 149, strips, renderPerspective, this);
+        views.run(jobs);
+    }
+
+    // The wall relative to the player: x across the view, z along it.
+    void viewSpace(f32& tx1, f32& tz1, f32& tx2, f32& tz2) const
+    {
+        tx1 = vx1 - px;
+        f32 ty1 = vy1 - py;
+        tx2 = vx2 - px;
+        f32 ty2 = vy2 - py;
+        tz1 = tx1 * cosf(angle) + ty1 * sinf(angle);
+        tz2 = tx2 * cosf(angle) + ty2 * sinf(angle);
         tx1 = tx1 * sinf(angle) - ty1 * cosf(angle);
         tx2 = tx2 * sinf(angle) - ty2 * cosf(angle);
+    }
 
-        ctx->setDrawColor(14);
-        ctx->line(50 - tx1, 50 - tz1, 50 - tx2, 50 - tz2);
-        ctx->setDrawColor(8);
-        ctx->line(50, 50, 50, 45);
-        ctx->setDrawColor(15);
-        ctx->point(50, 50);
+    static void renderMap(void* context, Canvas& ctx)
+    {
+        const TestRenderer* r = (const TestRenderer*)context;
+
+        ctx.setDrawColor(14);
+        ctx.line(r->vx1, r->vy1, r->vx2, r->vy2);
+        ctx.setDrawColor(8);
+        ctx.line(r->px, r->py, cosf(r->angle) * 5.f + r->px, sinf(r->angle) * 5.f + r->py);
+        ctx.setDrawColor(15);
+        ctx.point(r->px, r->py);
+    }
 
-        ctx->setDrawColor(3);
-        ctx->view(214, 40, 315, 149);
+    static void renderLocal(void* context, Canvas& ctx)
+    {
+        const TestRenderer* r = (const TestRenderer*)context;
+
+        f32 tx1, tz1, tx2, tz2;
+        r->viewSpace(tx1, tz1, tx2, tz2);
+
+        ctx.setDrawColor(14);
+        ctx.line(50 - tx1, 50 - tz1, 50 - tx2, 50 - tz2);
+        ctx.setDrawColor(8);
+        ctx.line(50, 50, 50, 45);
+        ctx.setDrawColor(15);
+        ctx.point(50, 50);
+    }
+
+    // One strip of the 3D panel. Every strip transforms and near-clips the
+    // wall itself, then keeps only the columns inside its own slice of the
+    // frustum. Column extents are interpolated in integers from the whole
+    // wall's projected ends, so any split draws the same pixels.
+    static void renderPerspective(void* context, Canvas& ctx, int first, int last)
+    {
+        const TestRenderer* r = (const TestRenderer*)context;
 
-        if (tz1 > 0 || tz2 > 0)
+        f32 tx1, tz1, tx2, tz2;
+        r->viewSpace(tx1, tz1, tx2, tz2);
+        if (tz1 <= 0 && tz2 <= 0)
         {
-            Vec2 i1 = intersect(tx1, tz1, tx2, tz2, -0.0001, 0.0001, -20, 5);
-            Vec2 i2 = intersect(tx1, tz1, tx2, tz2, 0.0001, 0.0001, 20, 5);
-            
-            if (tz1 <= 0)
-            {
-                if (i1.y > 0) { tx1 = i1.x; tz1 = i1.y; }
-                else { tx1 = i2.x; tz1 = i2.y; }
-            }
+            return;
+        }
 
-            if (tz2 <= 0)
-            {
-                if (i1.y > 0) { tx2 = i1.x; tz2 = i1.y; }
-                else { tx2 = i2.x; tz2 = i2.y; }
-            }
+        Vec2 i1 = intersect(tx1, tz1, tx2, tz2, -0.0001, 0.0001, -20, 5);
+        Vec2 i2 = intersect(tx1, tz1, tx2, tz2, 0.0001, 0.0001, 20, 5);
 
-            f32 x1 = -tx1 * 16 / tz1, y1a = -50 / tz1, y1b = 50 / tz1;
-            f32 x2 = -tx2 * 16 / tz2, y2a = -50 / tz2, y2b = 50 / tz2;
+        if (tz1 <= 0)
+        {
+            if (i1.y > 0) { tx1 = i1.x; tz1 = i1.y; }
+            else { tx1 = i2.x; tz1 = i2.y; }
+        }
 
-            ctx->setDrawColor(14);
-            /*f32 m = (f32)(y1b - y1a) / (f32)(y2b - y2a);
-            for (int i = 50 + x1; i < 50 + x2; ++i)
-            {
-                f32 n = (f32)(i - (50 + x1)) / (f32)((x1 + 50) - (x2 + 50));
-                f32 d = (m / 2.f) * n;
-                ctx->vline(i, y1a + 50 - d, y1b + 50 + d);
-            }*/
-            //ctx->triangle(50 + x1, 50 + y1a, 50 + x2, 50 + y2a, 50 + x1, 50 + y1b);
-            //ctx->triangle(50 + x2, 50 + y2a, 50 + x2, 50 + y2b, 50 + x1, 50 + y1b);
-            //ctx->quad(50 + x1, 50 + y1a, 50 + x2, 50 + y2a, 50 + x1, 50 + y1b, 50 + x2, 50 + y2b);
-            ctx->line(50 + x1, 50 + y1a, 50 + x2, 50 + y2a);
-            ctx->line(50 + x1, 50 + y1b, 50 + x2, 50 + y2b);
-            ctx->line(50 + x1, 50 + y1a, 50 + x1, 50 + y1b);
-            ctx->line(50 + x2, 50 + y2a, 50 + x2, 50 + y2b);
+        if (tz2 <= 0)
+        {
+            if (i1.y > 0) { tx2 = i1.x; tz2 = i1.y; }
+            else { tx2 = i2.x; tz2 = i2.y; }
         }
+
+        f32 x1 = -tx1 * 16 / tz1, y1a = -50 / tz1, y1b = 50 / tz1;
+        f32 x2 = -tx2 * 16 / tz2, y2a = -50 / tz2, y2b = 50 / tz2;
+
+        // Panel coordinates, truncated as the edge lines are.
+        int c1 = (int)(50 + x1), t1 = (int)(50 + y1a), b1 = (int)(50 + y1b);
+        int c2 = (int)(50 + x2), t2 = (int)(50 + y2a), b2 = (int)(50 + y2b);
+        if (Util::Max(c1, c2) < first || Util::Min(c1, c2) > last)
+        {
+            return;
+        }
+
+        // Filled left to right; the edges keep the wall's own direction
+        // since a line's pixels depend on which end it starts from.
+        const bool flip = c1 > c2;
+        const int cl = flip ? c2 : c1, cr = flip ? c1 : c2;
+        const int tl = flip ? t2 : t1, tr = flip ? t1 : t2;
+        const int bl = flip ? b2 : b1, br = flip ? b1 : b2;
+        const int64 span = Util::Max(cr - cl, 1);
+        ctx.setDrawColor(6);
+        for (int i = Util::Max(cl, first); i <= Util::Min(cr, last); ++i)
+        {
+            const int top = tl + (int)((int64)(tr - tl) * (i - cl) / span);
+            const int bottom = bl + (int)((int64)(br - bl) * (i - cl) / span);
+            ctx.vline(i, top, bottom);
+        }
+
+        ctx.setDrawColor(14);
+        ctx.line(c1, t1, c2, t2);
+        ctx.line(c1, b1, c2, b2);
+        ctx.line(c1, t1, c1, b1);
+        ctx.line(c2, t2, c2, b2);
     }
 
     int vx1 = 70, vy1 = 20;
@@ -147,68 +214,772 @@ struct TestRenderer
 
     f32 px = 50.f, py = 50.f;
     f32 angle = 0.f;
+
+    InputStamp stamp = InputStamp(); // the input this state reflects
+
+    // b with its pose moved back towards a by 1 - t.
+    static TestRenderer interpolate(const TestRenderer& a, const TestRenderer& b, f32 t)
+    {
+        TestRenderer r = b;
+        r.px = a.px + (b.px - a.px) * t;
+        r.py = a.py + (b.py - a.py) * t;
+        r.angle = a.angle + (b.angle - a.angle) * t;
+        return r;
+    }
 };
 
-int main(int argc, char* argv[])
+struct Options
+{
+    int width = 320;
+    int height = 240;
+    int scale = 1; // window is the internal resolution times this
+    PixelFormat format = PixelFormat::ABGR8888;
+    bool headless = false;
+    bool windowed = false;
+    PresentMode presentMode = PresentMode::VSync;
+    f64 capRate = 60.0; // frames per second with PresentMode::Capped
+    uint64 frames = 0; // 0 runs until quit
+    f64 dynresTargetMs = 0.0; // 0 keeps the full internal resolution
+    Interlace interlace = Interlace::None;
+    Reconstruct reconstruct = Reconstruct::Copy;
+    f32 gamma = 0.f; // 0 leaves colors as drawn
+    const char* gradePath = nullptr;
+    const char* postPasses = nullptr;
+    Dither dither = Dither::None;
+    int ditherSpread = 64;
+    const char* backdropPath = nullptr;
+    int threads = 0; // 0 uses every hardware thread
+    int strips = 0; // column strips in the 3D view; 0 uses one per job thread
+    bool pipeline = false; // simulate the next frame while this one renders
+    f64 tickRate = 0.0; // fixed simulation steps per second; 0 steps once per frame
+    int maxTicks = 5; // catch-up cap on steps run for one frame
+    int presentQueue = 0; // frames queued for a present thread; 0 presents inline
+
+    bool allocCheck = false;
+    bool memReport = false;
+
+    const char* capturePath = nullptr;
+    int captureFrames = 0;
+
+    const char* replayDrawPath = nullptr;
+    int replayLoops = 10;
+
+    const char* recordInputPath = nullptr;
+    const char* replayInputPath = nullptr;
+    const char* cameraPath = nullptr;
+};
+
+// Scripted camera: one "x y angle" line per frame, looped. Overrides whatever
+// update() did so the rendered view is independent of input.
+struct CameraPath
+{
+    bool load(const char* path)
+    {
+        FILE* file = fopen(path, "r");
+        if (!file)
+        {
+            SDL_Log("camera: could not open %s", path);
+            return false;
+        }
+
+        Key key;
+        while (fscanf(file, "%f %f %f", &key.x, &key.y, &key.angle) == 3)
+        {
+            keys.push_back(key);
+        }
+        fclose(file);
+
+        if (keys.empty())
+        {
+            SDL_Log("camera: %s has no keys", path);
+            return false;
+        }
+        return true;
+    }
+
+    void apply(uint64 frame, TestRenderer& renderer) const
+    {
+        const Key& key = keys[frame % keys.size()];
+        renderer.px = key.x;
+        renderer.py = key.y;
+        renderer.angle = key.angle;
+    }
+
+    struct Key
+    {
+        f32 x, y, angle;
+    };
+    std::vector<Key> keys;
+};
+
+// Everything update() touches. step() advances the live state by the
+// frame's fixed steps and publishes the pose to draw, blended between the
+// last two steps, for rasterization into states[frame & 1]; with -pipeline
+// the next frame can be simulated while this one is drawn.
+struct Simulation
+{
+    static void step(void* context, uint64 frame)
+    {
+        Simulation* sim = (Simulation*)context;
+        Memory::Scope memoryScope(Memory::Tag::Simulation);
+
+        for (int i = 0; i < sim->ticks; ++i)
+        {
+            if (i > 0)
+            {
+                sim->input.clearEdges();
+            }
+            sim->previous = sim->live;
+            sim->live.update(sim->input);
+            if (sim->camera)
+            {
+                sim->camera->apply(sim->tick, sim->live);
+            }
+            ++sim->tick;
+        }
+
+        TestRenderer& state = sim->states[frame & 1];
+        state = sim->alpha >= 1.f ? sim->live : TestRenderer::interpolate(sim->previous, sim->live, sim->alpha);
+        if (sim->ticks == 0)
+        {
+            // Already shown by an earlier frame.
+            state.stamp = InputStamp();
+        }
+        else if (state.stamp.sampled != 0)
+        {
+            state.stamp.updated = SDL_GetPerformanceCounter();
+        }
+    }
+
+    TestRenderer live;
+    TestRenderer previous; // live before its last step
+    TestRenderer states[2];
+    uint64 tick = 0; // steps run so far; camera keys are per step
+    // Set by the frame loop before each step.
+    InputManager input;
+    int ticks = 0;
+    f32 alpha = 1.f;
+    const CameraPath* camera = nullptr;
+};
+
+// Loads a BMP as an offscreen layer in ctx's format, converted once here so
+// every frame's blit is a plain copy. An indexed ctx keeps the palette
+// entries the demo draws with and fills the rest from a median cut of the
+// image; palette backs ctx's palette from then on.
+Canvas* loadBackdrop(const char* path, Video& ctx, SDL_Color* palette)
 {
-    _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
+    SDL_Surface* image = SDL_LoadBMP(path);
+    SDL_Surface* converted = image ? SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ARGB8888, 0) : nullptr;
+    SDL_FreeSurface(image);
+    if (!converted)
+    {
+        SDL_Log("backdrop: could not load %s: %s", path, SDL_GetError());
+        return nullptr;
+    }
+
+    Canvas source(converted->w, converted->h, PixelFormat::ARGB8888);
+    for (int y = 0; y < converted->h; ++y)
+    {
+        memcpy((uint8*)source.pixels() + y * source.pitch(), (const uint8*)converted->pixels + y * converted->pitch, converted->w * 4);
+    }
+    SDL_FreeSurface(converted);
+
+    Canvas* backdrop = new Canvas(source.width(), source.height(), ctx.format());
+    if (ctx.format() == PixelFormat::Indexed8)
+    {
+        // 32-bit rows are unpadded, so the surface is one run of pixels.
+        const int reserved = Util::Min(ctx.colorPaletteCount(), 255);
+        memcpy(palette, ctx.colorPalette(), reserved * sizeof(SDL_Color));
+        const int count = reserved + Palette::medianCut((const uint32*)source.pixels(), source.width() * source.height(),
+            palette + reserved, 256 - reserved);
+        ctx.setColorPalette(palette, count);
+        backdrop->setColorPalette(palette, count);
+        SDL_Log("backdrop: %s quantized to %d colors after %d reserved", path, count - reserved, reserved);
+    }
+    backdrop->blit(source, 0, 0);
+    return backdrop;
+}
 
-    const int cScreenWidth = 320;
-    const int cScreenHeight = 240;
+// events is null when there is no window to sample.
+int runFrameLoop(SDL_Window* window, const Options& options, InputQueue* events)
+{
+    Uint32 rendererFlags = SDL_RENDERER_ACCELERATED;
+    if (options.presentMode == PresentMode::VSync)
+    {
+        rendererFlags |= SDL_RENDERER_PRESENTVSYNC;
+    }
 
-    SDL_Window* window = SDL_CreateWindow("RenderDemon", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, cScreenWidth, cScreenHeight, SDL_WINDOW_SHOWN);
-    SDL_Renderer* sdlRenderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-    
-    Video ctx(cScreenWidth, cScreenHeight, sdlRenderer);
+    Video ctx(options.width, options.height, window, options.format, options.scale, rendererFlags);
     ctx.setClearColor(0, 0, 0);
     ctx.setDrawColor(255, 255, 255);
+    ctx.setInterlace(options.interlace, options.reconstruct);
+    if (options.presentQueue > 0 && options.interlace != Interlace::None)
+    {
+        // Interlacing draws over the previous frame, which is on another surface of the ring.
+        SDL_Log("present: -presentqueue cannot be combined with -interlace");
+        return 1;
+    }
+    ctx.setPresentQueue(options.presentQueue);
+
+    ColorGrade grade;
+    if (options.gradePath && !grade.loadCube(options.gradePath))
+    {
+        return 1;
+    }
+    else if (!options.gradePath && options.gamma > 0.f)
+    {
+        grade.setGamma(options.gamma);
+    }
+    ctx.setColorGrade(&grade);
+
+    JobSystem jobs(options.threads);
+    ctx.setJobSystem(&jobs);
+    ctx.setDither(options.dither, options.ditherSpread);
+    const int strips = options.strips > 0 ? options.strips : jobs.threads();
+    ViewBatch views(ctx, 2 + strips);
+
+    PostChain post(options.width, options.height, jobs);
+    if (options.postPasses && !post.parse(options.postPasses))
+    {
+        return 1;
+    }
+    if (!post.empty() && ctx.format() != PixelFormat::ARGB8888 && ctx.format() != PixelFormat::ABGR8888)
+    {
+        SDL_Log("post: %s framebuffers are not supported", pixelFormatName(ctx.format()));
+        return 1;
+    }
+    if (!post.empty() && options.interlace != Interlace::None)
+    {
+        // Interlacing keeps half of the previous frame, which would be filtered again.
+        SDL_Log("post: cannot be combined with -interlace");
+        return 1;
+    }
+
+    InputRecorder recorder;
+    if (options.recordInputPath && !recorder.open(options.recordInputPath))
+    {
+        return 1;
+    }
+
+    InputPlayback playback;
+    if (options.replayInputPath && !playback.load(options.replayInputPath))
+    {
+        return 1;
+    }
+
+    CameraPath camera;
+    if (options.cameraPath && !camera.load(options.cameraPath))
+    {
+        return 1;
+    }
+
+    SDL_Color backdropPalette[256];
+    Canvas* backdrop = nullptr;
+    if (options.backdropPath && !(backdrop = loadBackdrop(options.backdropPath, ctx, backdropPalette)))
+    {
+        return 1;
+    }
+
+    // Set up after everything that can fail, so no early return leaks it.
+    DrawCapture* capture = nullptr;
+    if (options.capturePath)
+    {
+        capture = new DrawCapture(options.capturePath, options.width, options.height, options.captureFrames);
+        ctx.setCapture(capture);
+    }
+
+    uint64 frameLimit = options.frames;
+    if (frameLimit == 0 && options.replayInputPath)
+    {
+        frameLimit = playback.frames();
+    }
+
+    // Without a window nothing can ask a headless run to stop.
+    const uint64 cHeadlessFrames = 1000;
+    if (frameLimit == 0 && !window)
+    {
+        frameLimit = cHeadlessFrames;
+    }
 
     InputManager input;
+    FrameProfiler profiler(16384);
+    LatencyProfiler latency(16384);
+    FramePacer pacer(options.presentMode == PresentMode::Capped ? options.capRate : 0.0, 16384);
+    ctx.setLatencyProfiler(&latency);
+    ResolutionController resolution(options.dynresTargetMs);
 
     bool running = true;
+    int exitCode = 0;
+    uint64 frame = 0;
+    const uint64 cWarmupFrames = 3;
 
-    TestRenderer renderer;
+    Simulation sim;
+    sim.camera = options.cameraPath ? &camera : nullptr;
+    FixedTimestep timestep(options.tickRate, options.maxTicks);
 
-    while (running)
+    FramePipeline* pipeline = nullptr;
+    if (options.pipeline)
     {
-        SDL_Event event;
-        while (SDL_PollEvent(&event))
+        pipeline = new FramePipeline(jobs, &Simulation::step, &sim);
+    }
+
+    // Takes whatever the sampler has queued since the last call.
+    auto pollEvents = [&]()
+    {
+        Memory::Scope memoryScope(Memory::Tag::Input);
+
+        const uint64 polled = SDL_GetPerformanceCounter();
+        InputEvent event;
+        while (events && events->pop(event))
         {
-            if (event.type == SDL_QUIT)
+            if (event.type == InputEventType::Quit)
             {
                 running = false;
             }
-            else if (event.type == SDL_KEYDOWN)
+            else if (event.type == InputEventType::KeyDown)
             {
-                if (event.key.keysym.scancode == SDL_SCANCODE_ESCAPE)
+                if (event.scancode == SDL_SCANCODE_ESCAPE)
                 {
                     running = false;
                 }
-                if (!event.key.repeat)
+                if (!options.replayInputPath)
                 {
-                    input.onKeyDown(event.key.keysym.scancode);
+                    input.onKeyDown(event.scancode);
+                    input.stampEvent(event.time, polled);
                 }
             }
-            else if (event.type == SDL_KEYUP)
+            else if (!options.replayInputPath)
             {
-                input.onKeyUp(event.key.keysym.scancode);
+                input.onKeyUp(event.scancode);
+                input.stampEvent(event.time, polled);
             }
         }
+    };
 
-        ctx.clear();
-        
-        renderer.update(input);
-        renderer.render(&ctx);
+    // Hands the input for a frame to the simulation. Only called while no
+    // step is running, so sim.input needs no second copy.
+    auto feedInput = [&](uint64 inputFrame)
+    {
+        if (options.replayInputPath)
+        {
+            playback.apply((uint32)inputFrame, input);
+        }
+        recorder.recordFrame((uint32)inputFrame, input);
 
-        //SDL_Delay(33);
+        // A frame that runs no step leaves its input, edges and stamp
+        // included, for the next one that does.
+        sim.ticks = timestep.advance();
+        sim.alpha = timestep.alpha();
+        if (sim.ticks > 0)
+        {
+            input.update();
+            sim.input = input;
+        }
+    };
 
-        ctx.present();
+    while (running && (frameLimit == 0 || frame < frameLimit))
+    {
+        Memory::beginFrame();
+        Memory::setFrameGuard(options.allocCheck && frame >= cWarmupFrames);
+        profiler.beginFrame();
 
-        input.update();
+        if (!pipeline || frame == 0)
+        {
+            pollEvents();
+            feedInput(frame);
+            if (pipeline)
+            {
+                pipeline->submit(frame);
+            }
+        }
+        profiler.mark(FrameProfiler::Events);
+
+        {
+            Memory::Scope memoryScope(Memory::Tag::Video);
+            ctx.clear();
+            if (backdrop)
+            {
+                ctx.blit(*backdrop, 0, 0);
+            }
+        }
+        profiler.mark(FrameProfiler::Clear);
+
+        if (pipeline)
+        {
+            // Only the part of the step that did not overlap the previous
+            // frame's raster shows up as update time.
+            pipeline->wait(frame);
+            profiler.mark(FrameProfiler::Update);
+
+            // Input for the next frame is read now, one frame earlier than
+            // in sequence, so its step can run alongside this raster.
+            pollEvents();
+            if (running && (frameLimit == 0 || frame + 1 < frameLimit))
+            {
+                feedInput(frame + 1);
+                pipeline->submit(frame + 1);
+            }
+            profiler.mark(FrameProfiler::Events);
+        }
+        else
+        {
+            Simulation::step(&sim, frame);
+            profiler.mark(FrameProfiler::Update);
+        }
+
+        {
+            Memory::Scope memoryScope(Memory::Tag::Simulation);
+            sim.states[frame & 1].render(&ctx, views, strips, &jobs);
+            profiler.mark(FrameProfiler::Render);
+        }
+
+        if (!post.empty())
+        {
+            Memory::Scope memoryScope(Memory::Tag::Video);
+            post.run(ctx);
+        }
+        profiler.mark(FrameProfiler::Post);
+
+        InputStamp& stamp = sim.states[frame & 1].stamp;
+        if (stamp.sampled != 0)
+        {
+            stamp.rendered = SDL_GetPerformanceCounter();
+        }
+
+        pacer.wait();
+        profiler.mark(FrameProfiler::Pace);
+
+        {
+            Memory::Scope memoryScope(Memory::Tag::Video);
+            ctx.present(&stamp);
+        }
+        pacer.presented();
+        profiler.mark(FrameProfiler::Present);
+
+        profiler.endFrame();
+
+        if (options.dynresTargetMs > 0.0)
+        {
+            f64 renderMs = profiler.lastPhaseMs(FrameProfiler::Clear) + profiler.lastPhaseMs(FrameProfiler::Render);
+            int percent = resolution.update(renderMs);
+            if (percent != ctx.renderScale())
+            {
+                ctx.setRenderScale(percent);
+                SDL_Log("dynres: frame %llu, render %.3f ms, now %d%% (%dx%d)", (unsigned long long)frame,
+                    renderMs, percent, ctx.renderWidth(), ctx.renderHeight());
+            }
+        }
+
+        Memory::setFrameGuard(false);
+        if (options.memReport)
+        {
+            Memory::reportFrame(frame);
+        }
+
+        if (Memory::guardViolations() > 0)
+        {
+            SDL_Log("alloccheck: heap allocation inside steady-state frame %llu", (unsigned long long)frame);
+            Memory::reportFrame(frame);
+            exitCode = 1;
+            running = false;
+        }
+
+        ++frame;
+    }
+
+    if (pipeline)
+    {
+        pipeline->finish();
+        delete pipeline;
+    }
+
+    ctx.setCapture(nullptr);
+    delete capture;
+    delete backdrop;
+
+    // Headless frames have no vblank to wait for.
+    const PresentMode presentMode = !window && options.presentMode == PresentMode::VSync ? PresentMode::Uncapped : options.presentMode;
+    SDL_Log("benchmark: %dx%d x%d %s %s, present %s, %s kernels", options.width, options.height, ctx.scale(), pixelFormatName(ctx.format()),
+        window ? "windowed" : "headless", presentModeName(presentMode), Kernels::levelName(ctx.kernelLevel()));
+    if (presentMode == PresentMode::Capped)
+    {
+        SDL_Log("benchmark: capped at %.1f fps", options.capRate);
+    }
+    if (options.interlace != Interlace::None)
+    {
+        SDL_Log("benchmark: %s interlace, %s reconstruction", options.interlace == Interlace::Rows ? "row" : "checkerboard",
+            options.reconstruct == Reconstruct::Blend ? "blend" : "copy");
+    }
+    if (!post.empty())
+    {
+        SDL_Log("benchmark: %d post passes, %d job threads, %d view strips", post.passes(), jobs.threads(), strips);
+    }
+    if (options.pipeline)
+    {
+        SDL_Log("benchmark: simulation pipelined one frame ahead of raster");
+    }
+    if (timestep.rate() > 0.0)
+    {
+        SDL_Log("benchmark: fixed step %.1f Hz, %llu steps, %llu dropped by the catch-up cap of %d",
+            timestep.rate(), (unsigned long long)timestep.steps(), (unsigned long long)timestep.dropped(), options.maxTicks);
+    }
+    if (ctx.presentQueue() > 0)
+    {
+        SDL_Log("benchmark: present thread, %d queued frames, %d surfaces", ctx.presentQueue(), ctx.presentQueue() + 1);
+    }
+    profiler.report();
+    pacer.report();
+
+    // Queued frames are shown first so that their latency is counted.
+    ctx.setPresentQueue(0);
+    ctx.setLatencyProfiler(nullptr);
+    latency.report();
+    if (options.dynresTargetMs > 0.0)
+    {
+        SDL_Log("benchmark: dynamic resolution target %.3f ms, %d changes, final %d%%",
+            options.dynresTargetMs, resolution.changes(), resolution.percent());
+    }
+
+    if (options.replayInputPath || options.cameraPath)
+    {
+        SDL_Log("benchmark: final position (%.4f, %.4f) angle %.4f", sim.live.px, sim.live.py, sim.live.angle);
+    }
+
+    return exitCode;
+}
+
+// Re-executes a draw capture headlessly as fast as possible and reports throughput.
+int runDrawReplay(const Options& options)
+{
+    DrawReplay replay;
+    if (!replay.load(options.replayDrawPath))
+    {
+        return 1;
+    }
+
+    Video ctx(replay.width(), replay.height(), nullptr, options.format);
+
+    // One untimed pass to warm caches.
+    replay.run(&ctx);
+
+    uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < options.replayLoops; ++i)
+    {
+        replay.run(&ctx);
     }
+    uint64 end = SDL_GetPerformanceCounter();
 
-    SDL_DestroyRenderer(sdlRenderer);
-    SDL_DestroyWindow(window);
+    f64 seconds = (f64)(end - start) / (f64)SDL_GetPerformanceFrequency();
+    f64 frames = (f64)replay.frames() * options.replayLoops;
+    f64 commands = (f64)replay.commands() * options.replayLoops;
+
+    SDL_Log("replay: %s %dx%d, %d frames, %d commands per pass, %d passes, %s kernels",
+        options.replayDrawPath, replay.width(), replay.height(), replay.frames(), replay.commands(), options.replayLoops,
+        Kernels::levelName(ctx.kernelLevel()));
+    SDL_Log("replay: %.3f s, %.1f frames/s, %.3f ms/frame, %.0f commands/s",
+        seconds, frames / seconds, seconds * 1000.0 / frames, commands / seconds);
 
     return 0;
+}
+
+void printUsage()
+{
+    SDL_Log("usage: RenderDemon [options]");
+    SDL_Log("  -headless                 render without a window or renderer (1000 frames unless -frames)");
+    SDL_Log("  -windowed                 force a window (e.g. with -replayinput)");
+    SDL_Log("  -present <mode>           vsync (default), uncapped or capped");
+    SDL_Log("  -cap <hz>                 capped at this rate by sleeping then spinning (default 60)");
+    SDL_Log("  -novsync                  same as -present uncapped");
+    SDL_Log("  -res <w>x<h>              internal resolution (default 320x240)");
+    SDL_Log("  -scale <n>                integer upscale to the window (default 1)");
+    SDL_Log("  -dynres <ms>              lower the render resolution to hold this clear+render time");
+    SDL_Log("  -interlace <mode> [blend] draw half the pixels per frame: rows or checker");
+    SDL_Log("  -gamma <g>                gamma-correct at present");
+    SDL_Log("  -grade <file.cube>        apply a 3D color LUT at present");
+    SDL_Log("  -post <passes>            post-process, e.g. gauss:2,bloom:200,scanlines:40,vignette:50");
+    SDL_Log("                            (box[:r], gauss[:r], bloom[:threshold], scanlines[:%%], vignette[:%%])");
+    SDL_Log("  -dither <mode> [spread]   indexed8 RGB colors: ordered or fs (Floyd-Steinberg blits)");
+    SDL_Log("  -backdrop <file.bmp>      draw an image behind every frame; indexed8 quantizes a palette for it");
+    SDL_Log("  -threads <n>              job system threads including the main one (default: all)");
+    SDL_Log("  -strips <n>               column strips in the 3D view (default: one per job thread)");
+    SDL_Log("  -pipeline                 simulate the next frame on its own thread during raster");
+    SDL_Log("  -tickrate <hz>            fixed simulation rate with interpolated rendering (default: once per frame)");
+    SDL_Log("  -maxticks <n>             most simulation steps one frame may catch up (default 5)");
+    SDL_Log("  -presentqueue <n>         present on its own thread with up to n queued frames (1 or 2)");
+    SDL_Log("  -format <format>          argb8888, abgr8888 (default), rgb565 or indexed8 framebuffer");
+    SDL_Log("  -frames <n>               stop after n frames");
+    SDL_Log("  -camera <file>            scripted camera path, one 'x y angle' line per frame");
+    SDL_Log("  -kernels <level>          force scalar, sse2, avx2 or neon raster kernels");
+    SDL_Log("  -recordinput <file>       record the per-frame key state");
+    SDL_Log("  -replayinput <file>       drive input from a recording (headless unless -windowed)");
+    SDL_Log("  -capture <file> <frames>  record every Video call for the next n frames");
+    SDL_Log("  -replaydraw <file> [n]    replay a draw capture n times headlessly");
+    SDL_Log("  -alloccheck               fail on any heap allocation after warm-up");
+    SDL_Log("  -memreport                log per-frame allocations by subsystem");
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-headless") == 0) { options.headless = true; }
+        else if (strcmp(argv[i], "-windowed") == 0) { options.windowed = true; }
+        else if (strcmp(argv[i], "-novsync") == 0) { options.presentMode = PresentMode::Uncapped; }
+        else if (strcmp(argv[i], "-present") == 0 && i + 1 < argc)
+        {
+            if (!parsePresentMode(argv[++i], &options.presentMode))
+            {
+                SDL_Log("unknown present mode '%s'", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-cap") == 0 && i + 1 < argc)
+        {
+            options.presentMode = PresentMode::Capped;
+            options.capRate = atof(argv[++i]);
+            if (!(options.capRate > 0.0))
+            {
+                SDL_Log("bad frame cap '%s'", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-res") == 0 && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 || options.width <= 0 || options.height <= 0)
+            {
+                SDL_Log("bad resolution '%s'", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-scale") == 0 && i + 1 < argc)
+        {
+            options.scale = atoi(argv[++i]);
+            if (options.scale <= 0)
+            {
+                SDL_Log("bad scale '%s'", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-dynres") == 0 && i + 1 < argc) { options.dynresTargetMs = atof(argv[++i]); }
+        else if (strcmp(argv[i], "-interlace") == 0 && i + 1 < argc)
+        {
+            ++i;
+            if (strcmp(argv[i], "rows") == 0) { options.interlace = Interlace::Rows; }
+            else if (strcmp(argv[i], "checker") == 0) { options.interlace = Interlace::Checkerboard; }
+            else
+            {
+                SDL_Log("unknown interlace mode '%s'", argv[i]);
+                return 1;
+            }
+
+            if (i + 1 < argc && strcmp(argv[i + 1], "blend") == 0)
+            {
+                options.reconstruct = Reconstruct::Blend;
+                ++i;
+            }
+        }
+        else if (strcmp(argv[i], "-gamma") == 0 && i + 1 < argc) { options.gamma = (f32)atof(argv[++i]); }
+        else if (strcmp(argv[i], "-grade") == 0 && i + 1 < argc) { options.gradePath = argv[++i]; }
+        else if (strcmp(argv[i], "-backdrop") == 0 && i + 1 < argc) { options.backdropPath = argv[++i]; }
+        else if (strcmp(argv[i], "-post") == 0 && i + 1 < argc) { options.postPasses = argv[++i]; }
+        else if (strcmp(argv[i], "-dither") == 0 && i + 1 < argc)
+        {
+            ++i;
+            if (strcmp(argv[i], "ordered") == 0) { options.dither = Dither::Ordered; }
+            else if (strcmp(argv[i], "fs") == 0) { options.dither = Dither::FloydSteinberg; }
+            else
+            {
+                SDL_Log("unknown dither mode '%s'", argv[i]);
+                return 1;
+            }
+
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                options.ditherSpread = atoi(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) { options.threads = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "-strips") == 0 && i + 1 < argc) { options.strips = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "-pipeline") == 0) { options.pipeline = true; }
+        else if (strcmp(argv[i], "-tickrate") == 0 && i + 1 < argc) { options.tickRate = atof(argv[++i]); }
+        else if (strcmp(argv[i], "-maxticks") == 0 && i + 1 < argc) { options.maxTicks = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "-presentqueue") == 0 && i + 1 < argc) { options.presentQueue = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "-format") == 0 && i + 1 < argc)
+        {
+            if (!parsePixelFormat(argv[++i], &options.format))
+            {
+                SDL_Log("unknown pixel format '%s'", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) { options.frames = strtoull(argv[++i], nullptr, 10); }
+        else if (strcmp(argv[i], "-camera") == 0 && i + 1 < argc) { options.cameraPath = argv[++i]; }
+        else if (strcmp(argv[i], "-kernels") == 0 && i + 1 < argc)
+        {
+            Kernels::Level level;
+            if (!Kernels::parseLevel(argv[++i], &level))
+            {
+                SDL_Log("unknown kernel level '%s'", argv[i]);
+                return 1;
+            }
+            Kernels::setOverride(level);
+        }
+        else if (strcmp(argv[i], "-alloccheck") == 0) { options.allocCheck = true; }
+        else if (strcmp(argv[i], "-memreport") == 0) { options.memReport = true; }
+        else if (strcmp(argv[i], "-capture") == 0 && i + 2 < argc)
+        {
+            options.capturePath = argv[++i];
+            options.captureFrames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-replaydraw") == 0 && i + 1 < argc)
+        {
+            options.replayDrawPath = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                options.replayLoops = atoi(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "-recordinput") == 0 && i + 1 < argc) { options.recordInputPath = argv[++i]; }
+        else if (strcmp(argv[i], "-replayinput") == 0 && i + 1 < argc) { options.replayInputPath = argv[++i]; }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    // Input replays are for repeatable measurement, so they default to headless.
+    if (options.replayInputPath && !options.windowed)
+    {
+        options.headless = true;
+    }
+
+    int exitCode = 0;
+    if (options.replayDrawPath)
+    {
+        exitCode = runDrawReplay(options);
+    }
+    else if (options.headless)
+    {
+        exitCode = runFrameLoop(nullptr, options, nullptr);
+    }
+    else
+    {
+        // The sampling thread owns the window and its events; the frames
+        // and every render call stay on this thread.
+        InputQueue events;
+        InputSampler sampler(events);
+        SDL_Window* window = sampler.start("RenderDemon", options.width * options.scale, options.height * options.scale);
+        exitCode = runFrameLoop(window, options, &events);
+        sampler.stop();
+        if (events.dropped() > 0)
+        {
+            SDL_Log("input: %u events dropped, queue full", events.dropped());
+        }
+    }
+
+    Memory::reportLeaks();
+
+    return exitCode;
 }
\ No newline at end of file